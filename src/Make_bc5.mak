@@ -572,6 +572,7 @@ vimobj =  \
 	$(OBJDIR)\misc2.obj \
 	$(OBJDIR)\move.obj \
 	$(OBJDIR)\mbyte.obj \
+	$(OBJDIR)\msgpack.obj \
 	$(OBJDIR)\normal.obj \
 	$(OBJDIR)\ops.obj \
 	$(OBJDIR)\option.obj \
@@ -702,6 +702,7 @@ OBJ = \
 	$(OUTDIR)/misc2.o \
 	$(OUTDIR)/move.o \
 	$(OUTDIR)/mbyte.o \
+	$(OUTDIR)/msgpack.o \
 	$(OUTDIR)/normal.o \
 	$(OUTDIR)/ops.o \
 	$(OUTDIR)/option.o \
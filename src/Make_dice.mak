@@ -61,6 +61,7 @@ SRC = \
 	misc2.c \
 	move.c \
 	mbyte.c \
+	msgpack.c \
 	normal.c \
 	ops.c \
 	option.c \
@@ -117,6 +118,7 @@ OBJ =	o/arabic.o \
 	o/misc2.o \
 	o/move.o \
 	o/mbyte.o \
+	o/msgpack.o \
 	o/normal.o \
 	o/ops.o \
 	o/option.o \
@@ -227,6 +229,8 @@ o/move.o:	move.c  $(SYMS)
 
 o/mbyte.o:	mbyte.c  $(SYMS)
 
+o/msgpack.o:	msgpack.c  $(SYMS)
+
 o/normal.o:	normal.c  $(SYMS)
 
 o/ops.o:	ops.c  $(SYMS)
@@ -245,6 +245,7 @@ LINK32_OBJS= \
 	"$(INTDIR)/misc1.obj" \
 	"$(INTDIR)/misc2.obj" \
 	"$(INTDIR)/move.obj" \
+	"$(INTDIR)/msgpack.obj" \
 	"$(INTDIR)/normal.obj" \
 	"$(INTDIR)/ops.obj" \
 	"$(INTDIR)/option.obj" \
@@ -627,6 +628,10 @@ SOURCE=.\move.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\msgpack.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\normal.c
 # End Source File
 # Begin Source File
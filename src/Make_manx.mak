@@ -71,6 +71,7 @@ SRC =	arabic.c \
 	misc2.c \
 	move.c \
 	mbyte.c \
+	msgpack.c \
 	normal.c \
 	ops.c \
 	option.c \
@@ -129,6 +130,7 @@ OBJ =	obj/arabic.o \
 	obj/misc2.o \
 	obj/move.o \
 	obj/mbyte.o \
+	obj/msgpack.o \
 	obj/normal.o \
 	obj/ops.o \
 	obj/option.o \
@@ -185,6 +187,7 @@ PRO =	proto/arabic.pro \
 	proto/misc2.pro \
 	proto/move.pro \
 	proto/mbyte.pro \
+	proto/msgpack.pro \
 	proto/normal.pro \
 	proto/ops.pro \
 	proto/option.pro \
@@ -358,6 +361,9 @@ obj/move.o:	move.c
 obj/mbyte.o: mbyte.c
 	$(CCSYM) $@ mbyte.c
 
+obj/msgpack.o:	msgpack.c
+	$(CCSYM) $@ msgpack.c
+
 obj/normal.o:	normal.c
 	$(CCSYM) $@ normal.c
 
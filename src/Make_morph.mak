@@ -59,6 +59,7 @@ SRC =	arabic.c						\
 	misc1.c							\
 	misc2.c							\
 	move.c							\
+	msgpack.c						\
 	normal.c						\
 	ops.c							\
 	option.c						\
@@ -733,6 +733,7 @@ OBJ = \
 	$(OUTDIR)\misc1.obj \
 	$(OUTDIR)\misc2.obj \
 	$(OUTDIR)\move.obj \
+	$(OUTDIR)\msgpack.obj \
 	$(OUTDIR)\normal.obj \
 	$(OUTDIR)\ops.obj \
 	$(OUTDIR)\option.obj \
@@ -1434,6 +1435,8 @@ $(OUTDIR)/move.obj:	$(OUTDIR) move.c  $(INCL)
 
 $(OUTDIR)/mbyte.obj: $(OUTDIR) mbyte.c  $(INCL)
 
+$(OUTDIR)/msgpack.obj:	$(OUTDIR) msgpack.c  $(INCL)
+
 $(OUTDIR)/netbeans.obj: $(OUTDIR) netbeans.c $(NBDEBUG_SRC) $(INCL)
 
 $(OUTDIR)/channel.obj: $(OUTDIR) channel.c $(INCL)
@@ -1600,6 +1603,7 @@ proto.h: \
 	proto/misc2.pro \
 	proto/move.pro \
 	proto/mbyte.pro \
+	proto/msgpack.pro \
 	proto/normal.pro \
 	proto/ops.pro \
 	proto/option.pro \
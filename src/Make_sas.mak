@@ -124,6 +124,7 @@ SRC = \
 	misc2.c \
 	move.c \
 	mbyte.c \
+	msgpack.c \
 	normal.c \
 	ops.c \
 	option.c \
@@ -181,6 +182,7 @@ OBJ = \
 	misc2.o \
 	move.o \
 	mbyte.o \
+	msgpack.o \
 	normal.o \
 	ops.o \
 	option.o \
@@ -238,6 +240,7 @@ PRO = \
 	proto/misc2.pro \
 	proto/move.pro \
 	proto/mbyte.pro \
+	proto/msgpack.pro \
 	proto/normal.pro \
 	proto/ops.pro \
 	proto/option.pro \
@@ -384,6 +387,8 @@ move.o:			move.c
 proto/move.pro:		move.c
 mbyte.o:		mbyte.c
 proto/mbyte.pro:	mbyte.c
+msgpack.o:		msgpack.c
+proto/msgpack.pro:	msgpack.c
 normal.o:		normal.c
 proto/normal.pro:	normal.c
 ops.o:			ops.c
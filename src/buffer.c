@@ -813,6 +813,9 @@ buf_freeall(buf_T *buf, int flags)
     }
 #ifdef FEAT_SYN_HL
     syntax_clear(&buf->b_s);	    /* reset syntax info */
+#endif
+#ifdef FEAT_SEARCH_EXTRA
+    hls_cache_free(buf);	    /* cached 'hlsearch' matches */
 #endif
     buf->b_flags &= ~BF_READERR;    /* a read error is no longer relevant */
 }
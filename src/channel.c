@@ -42,9 +42,13 @@
 # include <netinet/in.h>
 
 # include <sys/socket.h>
+# include <sys/uio.h>
 # ifdef HAVE_LIBGEN_H
 #  include <libgen.h>
 # endif
+# ifdef HAVE_EPOLL
+#  include <sys/epoll.h>
+# endif
 # define SOCK_ERRNO
 # define sock_write(sd, buf, len) write(sd, buf, len)
 # define sock_read(sd, buf, len) read(sd, buf, len)
@@ -55,6 +59,8 @@
 #endif
 
 static void channel_read(channel_T *channel, ch_part_T part, char *func);
+static void channel_clear_writeque(channel_T *channel, ch_part_T part);
+static void channel_check_watermark(channel_T *channel);
 
 /* Whether a redraw is needed for appending a line to a buffer. */
 static int channel_need_redraw = FALSE;
@@ -65,6 +71,30 @@ static int safe_to_invoke_callback = 0;
 
 static char *part_names[] = {"sock", "out", "err", "in"};
 
+/* Minimal free space in the read buffer when reading incoming messages. */
+#define MAXMSGSIZE 4096
+
+/* Size of the buffer readv() uses for what doesn't fit in the read buffer. */
+#define READ_EXTRA_SIZE (64 * 1024)
+
+#ifdef UNIX
+/* Buffer of READ_EXTRA_SIZE bytes used by channel_read(). */
+static char_u *read_extra = NULL;
+#endif
+
+/* Maximum size of a write queue entry, also used for the chunks of buffer
+ * lines written at once. */
+#define WRITEQ_ENTRY_SIZE (64 * 1024)
+
+/* Maximum number of write queue entries written with one writev(). */
+#define WRITEQ_IOV_MAX 16
+
+/* Default for the "write_high" option. */
+#define WRITE_HIGH_DEFAULT (1024 * 1024)
+
+/* Maximum number of received lines appended to a buffer at once. */
+#define APPEND_LINES_MAX 10000
+
 #ifdef WIN32
     static int
 fd_read(sock_T fd, char *buf, size_t len)
@@ -284,6 +314,7 @@ add_channel(void)
 #endif
 	channel->ch_part[part].ch_timeout = 2000;
     }
+    channel->ch_write_high = WRITE_HIGH_DEFAULT;
 
     if (first_channel != NULL)
     {
@@ -329,13 +360,13 @@ channel_still_useful(channel_T *channel)
     /* If there is no callback then nobody can get readahead.  If the fd is
      * closed and there is no readahead then the callback won't be called. */
     has_sock_msg = channel->ch_part[PART_SOCK].ch_fd != INVALID_FD
-		|| channel->ch_part[PART_SOCK].ch_head.rq_next != NULL
+		|| channel->ch_part[PART_SOCK].ch_readq.rq_buflen > 0
 		|| channel->ch_part[PART_SOCK].ch_json_head.jq_next != NULL;
     has_out_msg = channel->ch_part[PART_OUT].ch_fd != INVALID_FD
-		  || channel->ch_part[PART_OUT].ch_head.rq_next != NULL
+		  || channel->ch_part[PART_OUT].ch_readq.rq_buflen > 0
 		  || channel->ch_part[PART_OUT].ch_json_head.jq_next != NULL;
     has_err_msg = channel->ch_part[PART_ERR].ch_fd != INVALID_FD
-		  || channel->ch_part[PART_ERR].ch_head.rq_next != NULL
+		  || channel->ch_part[PART_ERR].ch_readq.rq_buflen > 0
 		  || channel->ch_part[PART_ERR].ch_json_head.jq_next != NULL;
     return (channel->ch_callback != NULL && (has_sock_msg
 		|| has_out_msg || has_err_msg))
@@ -646,6 +677,175 @@ channel_gui_unregister(channel_T *channel)
 
 #endif
 
+#ifdef HAVE_EPOLL
+/*
+ * On Linux the file descriptors of all channels are kept in an epoll set.
+ * It only changes when a channel is opened or closed, or starts or stops
+ * waiting for writing to be possible.  Waiting for a character then only
+ * needs to add the epoll fd to select() or poll(), instead of going over all
+ * channels every time.
+ */
+typedef struct {
+    channel_T	*ce_channel;	/* channel using the fd, NULL if unused */
+    int		ce_events;	/* events in the epoll set, zero if none */
+} ch_epoll_T;
+
+/* The epoll fd, -1 when not created yet, -2 when epoll is not used. */
+static int	channel_epoll_fd = -1;
+
+/* ch_epoll_T items, indexed by file descriptor. */
+static garray_T	channel_epoll_ga = {0, 0, sizeof(ch_epoll_T), 16, NULL};
+
+/* Keep-open channels with an fd to read from, these are polled. */
+static garray_T	channel_keep_open_ga = {0, 0, sizeof(channel_T *), 4, NULL};
+
+/*
+ * Give up on epoll, go back to adding all channels to select() or poll().
+ */
+    static void
+channel_epoll_disable(void)
+{
+    ch_error(NULL, "epoll failed, using select() or poll() instead");
+    if (channel_epoll_fd >= 0)
+	close(channel_epoll_fd);
+    channel_epoll_fd = -2;
+    ga_clear(&channel_epoll_ga);
+    ga_clear(&channel_keep_open_ga);
+}
+
+/*
+ * Make epoll wait for "events" on "fd" of "channel".  When "events" is zero
+ * "fd" is removed from the epoll set.
+ */
+    static void
+channel_epoll_set(int fd, channel_T *channel, int events)
+{
+    ch_epoll_T		*ce;
+    struct epoll_event	ev;
+    int			op;
+
+    if (channel_epoll_fd == -2)
+	return;
+    if (fd >= channel_epoll_ga.ga_len)
+    {
+	if (events == 0)
+	    return;
+	if (ga_grow(&channel_epoll_ga, fd + 1 - channel_epoll_ga.ga_len)
+								      == FAIL)
+	{
+	    channel_epoll_disable();
+	    return;
+	}
+	vim_memset((ch_epoll_T *)channel_epoll_ga.ga_data
+						     + channel_epoll_ga.ga_len,
+		0, (fd + 1 - channel_epoll_ga.ga_len) * sizeof(ch_epoll_T));
+	channel_epoll_ga.ga_len = fd + 1;
+    }
+    ce = (ch_epoll_T *)channel_epoll_ga.ga_data + fd;
+
+    if (ce->ce_events != events)
+    {
+	if (channel_epoll_fd == -1)
+	{
+	    channel_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	    if (channel_epoll_fd < 0)
+	    {
+		channel_epoll_disable();
+		return;
+	    }
+	}
+	op = ce->ce_events == 0 ? EPOLL_CTL_ADD
+			      : events == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+	vim_memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(channel_epoll_fd, op, fd, &ev) < 0)
+	{
+	    channel_epoll_disable();
+	    return;
+	}
+	ce->ce_events = events;
+    }
+    ce->ce_channel = events == 0 ? NULL : channel;
+}
+
+/*
+ * Make the epoll set match what "channel" waits for: reading on the sock,
+ * out and err parts, except for a keep-open channel, and writing on the sock
+ * and in parts when there is something to write.
+ * Must be called when any of these change.
+ */
+    static void
+channel_epoll_update(channel_T *channel)
+{
+    int		events[PART_COUNT];
+    int		keep_open = FALSE;
+    ch_part_T	part;
+    ch_part_T	other;
+    channel_T	**keep;
+    int		i;
+
+    if (channel_epoll_fd == -2)
+	return;
+
+    for (part = PART_SOCK; part < PART_COUNT; ++part)
+    {
+	chanpart_T *ch_part = &channel->ch_part[part];
+
+	events[part] = 0;
+	if (ch_part->ch_fd == INVALID_FD)
+	    continue;
+	if (part != PART_IN)
+	{
+	    if (channel->ch_keep_open)
+		keep_open = TRUE;
+	    else
+		events[part] = EPOLLIN;
+	}
+	if (ch_part->ch_writeque.wq_next != NULL
+		    || (part == PART_IN && ch_part->ch_bufref.br_buf != NULL))
+	    events[part] |= EPOLLOUT;
+    }
+
+    for (part = PART_SOCK; part < PART_COUNT; ++part)
+    {
+	sock_T	fd = channel->ch_part[part].ch_fd;
+	int	ev = events[part];
+
+	if (fd == INVALID_FD)
+	    continue;
+	/* When using a pty the same fd is used for several parts, combine
+	 * their events. */
+	for (other = PART_SOCK; other < part; ++other)
+	    if (channel->ch_part[other].ch_fd == fd)
+		break;
+	if (other < part)
+	    continue;
+	for (other = part + 1; other < PART_COUNT; ++other)
+	    if (channel->ch_part[other].ch_fd == fd)
+		ev |= events[other];
+	channel_epoll_set((int)fd, channel, ev);
+    }
+    if (channel_epoll_fd == -2)
+	return;
+
+    keep = (channel_T **)channel_keep_open_ga.ga_data;
+    for (i = 0; i < channel_keep_open_ga.ga_len; ++i)
+	if (keep[i] == channel)
+	    break;
+    if (keep_open && i == channel_keep_open_ga.ga_len)
+    {
+	if (ga_grow(&channel_keep_open_ga, 1) == FAIL)
+	    channel_epoll_disable();
+	else
+	    ((channel_T **)channel_keep_open_ga.ga_data)
+				     [channel_keep_open_ga.ga_len++] = channel;
+    }
+    else if (!keep_open && i < channel_keep_open_ga.ga_len)
+	keep[i] = keep[--channel_keep_open_ga.ga_len];
+}
+#endif
+
 static char *e_cannot_connect = N_("E902: Cannot connect to port");
 
 /*
@@ -906,17 +1106,19 @@ channel_open(
 
     ch_log(channel, "Connection made");
 
+#ifdef _WIN32
     if (waittime >= 0)
     {
-#ifdef _WIN32
 	val = 0;
 	ioctlsocket(sd, FIONBIO, &val);
-#else
-	(void)fcntl(sd, F_SETFL, 0);
-#endif
     }
+#endif
 
     channel->CH_SOCK_FD = (sock_T)sd;
+#ifndef _WIN32
+    /* Writing must not block, what can't be written now is queued. */
+    channel_set_nonblock(channel, PART_SOCK);
+#endif
     channel->ch_nb_close_cb = nb_close_cb;
     channel->ch_hostname = (char *)vim_strsave((char_u *)hostname);
     channel->ch_port = port_in;
@@ -925,6 +1127,9 @@ channel_open(
 #ifdef FEAT_GUI
     channel_gui_register_one(channel, PART_SOCK);
 #endif
+#ifdef HAVE_EPOLL
+    channel_epoll_update(channel);
+#endif
 
     return channel;
 }
@@ -971,7 +1176,8 @@ channel_open_func(typval_T *argvars)
     opt.jo_mode = MODE_JSON;
     opt.jo_timeout = 2000;
     if (get_job_options(&argvars[1], &opt,
-	    JO_MODE_ALL + JO_CB_ALL + JO_WAITTIME + JO_TIMEOUT_ALL, 0) == FAIL)
+	    JO_MODE_ALL + JO_CB_ALL + JO_WAITTIME + JO_TIMEOUT_ALL,
+					     JO2_BATCH + JO2_WRITE_ALL) == FAIL)
 	goto theend;
     if (opt.jo_timeout < 0)
     {
@@ -998,7 +1204,12 @@ ch_close_part(channel_T *channel, ch_part_T part)
     if (*fd != INVALID_FD)
     {
 	if (part == PART_SOCK)
+	{
+#ifdef HAVE_EPOLL
+	    channel_epoll_set((int)*fd, NULL, 0);
+#endif
 	    sock_close(*fd);
+	}
 	else
 	{
 	    /* When using a pty the same FD is set on multiple parts, only
@@ -1007,6 +1218,9 @@ ch_close_part(channel_T *channel, ch_part_T part)
 		    && (part == PART_OUT || channel->CH_OUT_FD != *fd)
 		    && (part == PART_ERR || channel->CH_ERR_FD != *fd))
 	    {
+#ifdef HAVE_EPOLL
+		channel_epoll_set((int)*fd, NULL, 0);
+#endif
 #ifdef WIN32
 		if (channel->ch_named_pipe)
 		    DisconnectNamedPipe((HANDLE)fd);
@@ -1015,6 +1229,12 @@ ch_close_part(channel_T *channel, ch_part_T part)
 	    }
 	}
 	*fd = INVALID_FD;
+	if (part == PART_SOCK || part == PART_IN)
+	    channel_clear_writeque(channel, part);
+#ifdef HAVE_EPOLL
+	/* Another part may still use the fd. */
+	channel_epoll_update(channel);
+#endif
 
 	/* channel is closed, may want to end the job if it was the last */
 	channel->ch_to_be_closed &= ~(1U << part);
@@ -1033,6 +1253,9 @@ channel_set_pipes(channel_T *channel, sock_T in, sock_T out, sock_T err)
 	 * the job ended. */
 	if (isatty(in))
 	    channel->ch_to_be_closed |= (1U << PART_IN);
+
+	/* Writing must not block, what can't be written now is queued. */
+	channel_set_nonblock(channel, PART_IN);
 # endif
     }
     if (out != INVALID_FD)
@@ -1066,6 +1289,9 @@ channel_set_pipes(channel_T *channel, sock_T in, sock_T out, sock_T err)
 # endif
 	}
     }
+#ifdef HAVE_EPOLL
+    channel_epoll_update(channel);
+#endif
 }
 
 /*
@@ -1106,6 +1332,9 @@ channel_set_job(channel_T *channel, job_T *job, jobopt_T *options)
 	    in_part->ch_buf_bot = options->jo_in_bot;
 	else
 	    in_part->ch_buf_bot = in_part->ch_bufref.br_buf->b_ml.ml_line_count;
+#ifdef HAVE_EPOLL
+	channel_epoll_update(channel);
+#endif
     }
 }
 
@@ -1216,6 +1445,16 @@ channel_set_options(channel_T *channel, jobopt_T *opt)
     if (opt->jo_set & JO_CLOSE_CALLBACK)
 	set_callback(&channel->ch_close_cb, &channel->ch_close_partial,
 		opt->jo_close_cb, opt->jo_close_partial);
+    if (opt->jo_set2 & JO2_DRAIN_CB)
+	set_callback(&channel->ch_drain_cb, &channel->ch_drain_partial,
+		opt->jo_drain_cb, opt->jo_drain_partial);
+    if (opt->jo_set2 & JO2_BATCH)
+	for (part = PART_SOCK; part < PART_IN; ++part)
+	    channel->ch_part[part].ch_batch = opt->jo_batch;
+    if (opt->jo_set2 & JO2_WRITE_HIGH)
+	channel->ch_write_high = opt->jo_write_high;
+    if (opt->jo_set2 & JO2_WRITE_LOW)
+	channel->ch_write_low = opt->jo_write_low;
     channel->ch_drop_never = opt->jo_drop_never;
 
     if ((opt->jo_set & JO_OUT_IO) && opt->jo_io[PART_OUT] == JIO_BUFFER)
@@ -1344,34 +1583,6 @@ channel_set_req_callback(
     }
 }
 
-    static void
-write_buf_line(buf_T *buf, linenr_T lnum, channel_T *channel)
-{
-    char_u  *line = ml_get_buf(buf, lnum, FALSE);
-    int	    len = (int)STRLEN(line);
-    char_u  *p;
-    int	    i;
-
-    /* Need to make a copy to be able to append a NL. */
-    if ((p = alloc(len + 2)) == NULL)
-	return;
-    memcpy((char *)p, (char *)line, len);
-
-    if (channel->ch_write_text_mode)
-	p[len] = CAR;
-    else
-    {
-	for (i = 0; i < len; ++i)
-	    if (p[i] == NL)
-		p[i] = NUL;
-
-	p[len] = NL;
-    }
-    p[len + 1] = NUL;
-    channel_send(channel, PART_IN, p, len + 1, "write_buf_line");
-    vim_free(p);
-}
-
 /*
  * Return TRUE if "channel" can be written to.
  * Returns FALSE if the input is closed or the write would block.
@@ -1441,6 +1652,66 @@ can_write_buf_line(channel_T *channel)
     return TRUE;
 }
 
+/*
+ * Write lines "*lnum" to "last" of "buf" to the input of "channel", for as
+ * long as writing does not block.  Lines are collected in chunks of up to
+ * WRITEQ_ENTRY_SIZE bytes, so that many short lines do not each need a
+ * system call.
+ * "*lnum" is advanced to the first line that was not written.
+ * Returns the number of lines written.
+ */
+    static int
+channel_write_buf_lines(
+	channel_T   *channel,
+	buf_T	    *buf,
+	linenr_T    *lnum,
+	linenr_T    last)
+{
+    chanpart_T	*in_part = &channel->ch_part[PART_IN];
+    garray_T	ga;
+    int		written = 0;
+
+    ga_init2(&ga, 1, WRITEQ_ENTRY_SIZE);
+    while (*lnum <= last && in_part->ch_writeque.wq_next == NULL
+						&& can_write_buf_line(channel))
+    {
+	ga.ga_len = 0;
+	while (*lnum <= last && ga.ga_len < WRITEQ_ENTRY_SIZE)
+	{
+	    char_u  *line = ml_get_buf(buf, *lnum, FALSE);
+	    int	    len = (int)STRLEN(line);
+	    char_u  *p;
+	    int	    i;
+
+	    if (ga_grow(&ga, len + 1) == FAIL)
+		break;
+	    p = (char_u *)ga.ga_data + ga.ga_len;
+	    mch_memmove(p, line, len);
+
+	    if (channel->ch_write_text_mode)
+		p[len] = CAR;
+	    else
+	    {
+		for (i = 0; i < len; ++i)
+		    if (p[i] == NL)
+			p[i] = NUL;
+
+		p[len] = NL;
+	    }
+	    ga.ga_len += len + 1;
+	    ++*lnum;
+	    ++written;
+	}
+	if (ga.ga_len == 0)
+	    break;  /* out of memory! */
+	if (channel_send(channel, PART_IN, ga.ga_data, ga.ga_len,
+						 "write_buf_line") == FAIL)
+	    break;
+    }
+    ga_clear(&ga);
+    return written;
+}
+
 /*
  * Write any buffer lines to the input channel.
  */
@@ -1459,17 +1730,16 @@ channel_write_in(channel_T *channel)
 	/* buffer was wiped out or unloaded */
 	ch_log(channel, "input buffer has been wiped out");
 	in_part->ch_bufref.br_buf = NULL;
+#ifdef HAVE_EPOLL
+	channel_epoll_update(channel);
+#endif
 	return;
     }
 
-    for (lnum = in_part->ch_buf_top; lnum <= in_part->ch_buf_bot
-				   && lnum <= buf->b_ml.ml_line_count; ++lnum)
-    {
-	if (!can_write_buf_line(channel))
-	    break;
-	write_buf_line(buf, lnum, channel);
-	++written;
-    }
+    lnum = in_part->ch_buf_top;
+    written = channel_write_buf_lines(channel, buf, &lnum,
+		   in_part->ch_buf_bot < buf->b_ml.ml_line_count
+			       ? in_part->ch_buf_bot : buf->b_ml.ml_line_count);
 
     if (written == 1)
 	ch_log(channel, "written line %d to channel", (int)lnum - 1);
@@ -1489,8 +1759,9 @@ channel_write_in(channel_T *channel)
 	in_part->ch_bufref.br_buf = NULL;
 	ch_log(channel, "Finished writing all lines to channel");
 
-	/* Close the pipe/socket, so that the other side gets EOF. */
-	ch_close_part(channel, PART_IN);
+	/* Close the pipe/socket, so that the other side gets EOF.  When lines
+	 * are still queued this happens once they have been written. */
+	channel_close_in(channel);
     }
     else
 	ch_log(channel, "Still %ld more lines to write",
@@ -1516,6 +1787,10 @@ channel_buffer_free(buf_T *buf)
 		ch_log(channel, "%s buffer has been wiped out",
 							    part_names[part]);
 		ch_part->ch_bufref.br_buf = NULL;
+#ifdef HAVE_EPOLL
+		if (part == PART_IN)
+		    channel_epoll_update(channel);
+#endif
 	    }
 	}
 }
@@ -1526,17 +1801,27 @@ channel_buffer_free(buf_T *buf)
     static void
 channel_write_input(channel_T *channel)
 {
+    chanpart_T	*sock_part = &channel->ch_part[PART_SOCK];
     chanpart_T	*in_part = &channel->ch_part[PART_IN];
 
+    if (sock_part->ch_writeque.wq_next != NULL)
+	channel_send(channel, PART_SOCK, (char_u *)"", 0,
+							"channel_write_input");
     if (in_part->ch_writeque.wq_next != NULL)
 	channel_send(channel, PART_IN, (char_u *)"", 0, "channel_write_input");
-    else if (in_part->ch_bufref.br_buf != NULL)
+    if (in_part->ch_writeque.wq_next == NULL
+					   && in_part->ch_bufref.br_buf != NULL)
     {
 	if (in_part->ch_buf_append)
 	    channel_write_new_lines(in_part->ch_bufref.br_buf);
 	else
 	    channel_write_in(channel);
     }
+    if (in_part->ch_close_written && in_part->ch_writeque.wq_next == NULL)
+    {
+	ch_log(channel, "Write queue empty, closing in part");
+	ch_close_part(channel, PART_IN);
+    }
 }
 
 /*
@@ -1573,14 +1858,9 @@ channel_write_new_lines(buf_T *buf)
 	    if (in_part->ch_fd == INVALID_FD)
 		continue;  /* pipe was closed */
 	    found_one = TRUE;
-	    for (lnum = in_part->ch_buf_bot; lnum < buf->b_ml.ml_line_count;
-								       ++lnum)
-	    {
-		if (!can_write_buf_line(channel))
-		    break;
-		write_buf_line(buf, lnum, channel);
-		++written;
-	    }
+	    lnum = in_part->ch_buf_bot;
+	    written = channel_write_buf_lines(channel, buf, &lnum,
+					       buf->b_ml.ml_line_count - 1);
 
 	    if (written == 1)
 		ch_log(channel, "written line %d to channel", (int)lnum - 1);
@@ -1621,15 +1901,15 @@ invoke_callback(channel_T *channel, char_u *callback, partial_T *partial,
 }
 
 /*
- * Return the first node from "channel"/"part" without removing it.
+ * Return the read buffer of "channel"/"part" if it has text.
  * Returns NULL if there is nothing.
  */
     readq_T *
 channel_peek(channel_T *channel, ch_part_T part)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
 
-    return head->rq_next;
+    return rq->rq_buflen > 0 ? rq : NULL;
 }
 
 /*
@@ -1650,67 +1930,144 @@ channel_first_nl(readq_T *node)
 }
 
 /*
- * Return the first buffer from channel "channel"/"part" and remove it.
+ * Free the read buffer of "channel"/"part".
+ */
+    static void
+channel_readq_free(channel_T *channel, ch_part_T part)
+{
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+
+    VIM_CLEAR(rq->rq_alloc);
+    rq->rq_buffer = NULL;
+    rq->rq_buflen = 0;
+    rq->rq_size = 0;
+}
+
+/*
+ * Make room for adding "len" bytes to the read buffer of "channel"/"part".
+ * Moves the text to the start when more than half of the buffer was consumed,
+ * otherwise doubles the size, so that adding text is O(1) on average.
+ * Returns a pointer to where the text is to be added, NULL when out of
+ * memory.
+ */
+    static char_u *
+channel_readq_space(channel_T *channel, ch_part_T part, long_u len)
+{
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+    long_u  need = rq->rq_buflen + len + 1;
+    long_u  skip;
+    long_u  size;
+    char_u  *p;
+
+    if (rq->rq_alloc != NULL)
+    {
+	skip = (long_u)(rq->rq_buffer - rq->rq_alloc);
+	if (skip + need <= rq->rq_size)
+	    return rq->rq_buffer + rq->rq_buflen;
+	if (need <= rq->rq_size && skip >= rq->rq_size / 2)
+	{
+	    mch_memmove(rq->rq_alloc, rq->rq_buffer, rq->rq_buflen + 1);
+	    rq->rq_buffer = rq->rq_alloc;
+	    return rq->rq_buffer + rq->rq_buflen;
+	}
+    }
+
+    size = rq->rq_size * 2;
+    if (size < need)
+	size = need;
+    if (size < MAXMSGSIZE)
+	size = MAXMSGSIZE;
+    p = lalloc(size, TRUE);
+    if (p == NULL)
+	return NULL;
+    if (rq->rq_alloc != NULL)
+	mch_memmove(p, rq->rq_buffer, rq->rq_buflen);
+    p[rq->rq_buflen] = NUL;
+    vim_free(rq->rq_alloc);
+    rq->rq_alloc = p;
+    rq->rq_buffer = p;
+    rq->rq_size = size;
+    return rq->rq_buffer + rq->rq_buflen;
+}
+
+/*
+ * "len" bytes were put at "p", at the end of the text in the read buffer of
+ * "channel"/"part".  Make them part of the text.
+ */
+    static void
+channel_readq_added(
+	channel_T   *channel,
+	ch_part_T   part,
+	char_u	    *p,
+	long_u	    len,
+	char	    *lead)
+{
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+    char_u  *d;
+    long_u  i;
+
+    if (ch_log_active() && lead != NULL)
+    {
+	ch_log_lead(lead, channel);
+	fprintf(log_fd, "'");
+	ignored = (int)fwrite(p, len, 1, log_fd);
+	fprintf(log_fd, "'\n");
+    }
+
+    if (channel->ch_part[part].ch_mode == MODE_NL)
+    {
+	/* Drop any CR before a NL. */
+	d = p;
+	for (i = 0; i < len; ++i)
+	    if (p[i] != CAR || i + 1 >= len || p[i + 1] != NL)
+		*d++ = p[i];
+	len = (long_u)(d - p);
+    }
+    /* A NUL is added at the end, because netbeans code expects that.
+     * Otherwise a NUL may appear inside the text. */
+    p[len] = NUL;
+    rq->rq_buflen += len;
+}
+
+/*
+ * Return all the text read for "channel"/"part" and remove it.
  * The caller must free it.
  * Returns NULL if there is nothing.
  */
     char_u *
 channel_get(channel_T *channel, ch_part_T part)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    char_u *p;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
+    char_u  *p;
 
-    if (node == NULL)
+    if (rq->rq_buflen == 0)
 	return NULL;
-    /* dispose of the node but keep the buffer */
-    p = node->rq_buffer;
-    head->rq_next = node->rq_next;
-    if (node->rq_next == NULL)
-	head->rq_prev = NULL;
-    else
-	node->rq_next->rq_prev = NULL;
-    vim_free(node);
+    if (rq->rq_buffer == rq->rq_alloc)
+    {
+	/* Nothing was consumed, take over the buffer. */
+	p = rq->rq_alloc;
+	rq->rq_alloc = NULL;
+	channel_readq_free(channel, part);
+	return p;
+    }
+    p = vim_strnsave(rq->rq_buffer, (int)rq->rq_buflen);
+    if (p != NULL)
+	channel_consume(channel, part, (int)rq->rq_buflen);
     return p;
 }
 
 /*
- * Returns the whole buffer contents concatenated for "channel"/"part".
+ * Returns the whole buffer contents for "channel"/"part".
  * Replaces NUL bytes with NL.
  */
     static char_u *
 channel_get_all(channel_T *channel, ch_part_T part)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    long_u  len = 0;
-    char_u  *res;
-    char_u  *p;
-
-    /* If there is only one buffer just get that one. */
-    if (head->rq_next == NULL || head->rq_next->rq_next == NULL)
-	return channel_get(channel, part);
+    long_u  len = channel->ch_part[part].ch_readq.rq_buflen;
+    char_u  *res = channel_get(channel, part);
 
-    /* Concatenate everything into one buffer. */
-    for (node = head->rq_next; node != NULL; node = node->rq_next)
-	len += node->rq_buflen;
-    res = lalloc(len + 1, TRUE);
     if (res == NULL)
 	return NULL;
-    p = res;
-    for (node = head->rq_next; node != NULL; node = node->rq_next)
-    {
-	mch_memmove(p, node->rq_buffer, node->rq_buflen);
-	p += node->rq_buflen;
-    }
-    *p = NUL;
-
-    /* Free all buffers */
-    do
-    {
-	p = channel_get(channel, part);
-	vim_free(p);
-    } while (p != NULL);
 
     /* turn all NUL into NL */
     while (len > 0)
@@ -1723,199 +2080,218 @@ channel_get_all(channel_T *channel, ch_part_T part)
     return res;
 }
 
+/* Keep a read buffer up to this size when it becomes empty. */
+#define READQ_KEEP_SIZE (64 * 1024)
+
+/* Longer messages in "msgpack" mode are rejected. */
+#define MSGPACK_MAX_LEN (64L * 1024 * 1024)
+
 /*
- * Consume "len" bytes from the head of "node".
+ * Consume "len" bytes from the start of the text of "channel"/"part".
  * Caller must check these bytes are available.
  */
     void
 channel_consume(channel_T *channel, ch_part_T part, int len)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    char_u *buf = node->rq_buffer;
+    readq_T *rq = &channel->ch_part[part].ch_readq;
 
-    mch_memmove(buf, buf + len, node->rq_buflen - len);
-    node->rq_buflen -= len;
+    rq->rq_buflen -= len;
+    if (rq->rq_buflen > 0)
+	rq->rq_buffer += len;
+    else if (rq->rq_size > READQ_KEEP_SIZE)
+	channel_readq_free(channel, part);
+    else if (rq->rq_alloc != NULL)
+    {
+	rq->rq_buffer = rq->rq_alloc;
+	*rq->rq_buffer = NUL;
+    }
 }
 
 /*
- * Collapses the first and second buffer for "channel"/"part".
- * Returns FAIL if that is not possible.
- * When "want_nl" is TRUE collapse more buffers until a NL is found.
+ * Append "buf[len]" to the read buffer of "channel"/"part".
+ * Returns OK or FAIL.
  */
-    int
-channel_collapse(channel_T *channel, ch_part_T part, int want_nl)
+    static int
+channel_save(channel_T *channel, ch_part_T part, char_u *buf, int len,
+								   char *lead)
 {
-    readq_T *head = &channel->ch_part[part].ch_head;
-    readq_T *node = head->rq_next;
-    readq_T *last_node;
-    readq_T *n;
-    char_u  *newbuf;
-    char_u  *p;
-    long_u len;
+    char_u  *p = channel_readq_space(channel, part, (long_u)len);
 
-    if (node == NULL || node->rq_next == NULL)
-	return FAIL;
+    if (p == NULL)
+	return FAIL;	    /* out of memory */
+    mch_memmove(p, buf, len);
+    channel_readq_added(channel, part, p, (long_u)len, lead);
+    return OK;
+}
 
-    last_node = node->rq_next;
-    len = node->rq_buflen + last_node->rq_buflen + 1;
-    if (want_nl)
-	while (last_node->rq_next != NULL
-		&& channel_first_nl(last_node) == NULL)
-	{
-	    last_node = last_node->rq_next;
-	    len += last_node->rq_buflen;
-	}
+/*
+ * Add message "listtv" decoded from "channel"/"part" to the queue.  It is
+ * dropped when it is not a list with at least two items.
+ */
+    static void
+channel_add_json_msg(channel_T *channel, ch_part_T part, typval_T *listtv)
+{
+    jsonq_T	*head = &channel->ch_part[part].ch_json_head;
+    jsonq_T	*item;
 
-    p = newbuf = alloc(len);
-    if (newbuf == NULL)
-	return FAIL;	    /* out of memory */
-    mch_memmove(p, node->rq_buffer, node->rq_buflen);
-    p += node->rq_buflen;
-    vim_free(node->rq_buffer);
-    node->rq_buffer = newbuf;
-    for (n = node; n != last_node; )
+    /* Only accept the response when it is a list with at least two
+     * items. */
+    if (listtv->v_type != VAR_LIST || listtv->vval.v_list->lv_len < 2)
     {
-	n = n->rq_next;
-	mch_memmove(p, n->rq_buffer, n->rq_buflen);
-	p += n->rq_buflen;
-	vim_free(n->rq_buffer);
+	if (listtv->v_type != VAR_LIST)
+	    ch_error(channel, "Did not receive a list, discarding");
+	else
+	    ch_error(channel, "Expected list with two items, got %d",
+					       listtv->vval.v_list->lv_len);
+	clear_tv(listtv);
+	return;
     }
-    node->rq_buflen = (long_u)(p - newbuf);
 
-    /* dispose of the collapsed nodes and their buffers */
-    for (n = node->rq_next; n != last_node; )
+    item = (jsonq_T *)alloc((unsigned)sizeof(jsonq_T));
+    if (item == NULL)
+    {
+	clear_tv(listtv);
+	return;
+    }
+    item->jq_no_callback = FALSE;
+    item->jq_value = alloc_tv();
+    if (item->jq_value == NULL)
     {
-	n = n->rq_next;
-	vim_free(n->rq_prev);
+	vim_free(item);
+	clear_tv(listtv);
+	return;
     }
-    node->rq_next = last_node->rq_next;
-    if (last_node->rq_next == NULL)
-	head->rq_prev = node;
+    *item->jq_value = *listtv;
+    item->jq_prev = head->jq_prev;
+    head->jq_prev = item;
+    item->jq_next = NULL;
+    if (item->jq_prev == NULL)
+	head->jq_next = item;
     else
-	last_node->rq_next->rq_prev = node;
-    vim_free(last_node);
-    return OK;
+	item->jq_prev->jq_next = item;
 }
 
 /*
- * Store "buf[len]" on "channel"/"part".
- * When "prepend" is TRUE put in front, otherwise append at the end.
- * Returns OK or FAIL.
+ * Called when the read buffer of "chanpart" holds an incomplete message of
+ * "buflen" bytes.  The first time, and when more text arrived, set a deadline
+ * of 100 msec to wait for the rest.
+ * Returns TRUE when the deadline has passed and the input must be dropped.
  */
     static int
-channel_save(channel_T *channel, ch_part_T part, char_u *buf, int len,
-						      int prepend, char *lead)
+channel_incomplete_timeout(
+	channel_T   *channel,
+	chanpart_T  *chanpart,
+	size_t	    buflen)
 {
-    readq_T *node;
-    readq_T *head = &channel->ch_part[part].ch_head;
-    char_u  *p;
-    int	    i;
+    int timeout;
 
-    node = (readq_T *)alloc(sizeof(readq_T));
-    if (node == NULL)
-	return FAIL;	    /* out of memory */
-    /* A NUL is added at the end, because netbeans code expects that.
-     * Otherwise a NUL may appear inside the text. */
-    node->rq_buffer = alloc(len + 1);
-    if (node->rq_buffer == NULL)
+    if (chanpart->ch_wait_len < buflen)
     {
-	vim_free(node);
-	return FAIL;	    /* out of memory */
+	/* First time encountering incomplete message or after receiving
+	 * more (but still incomplete): set a deadline of 100 msec. */
+	ch_log(channel,
+		"Incomplete message (%d bytes) - wait 100 msec for more",
+		(int)buflen);
+	chanpart->ch_wait_len = buflen;
+#ifdef WIN32
+	chanpart->ch_deadline = GetTickCount() + 100L;
+#else
+	gettimeofday(&chanpart->ch_deadline, NULL);
+	chanpart->ch_deadline.tv_usec += 100 * 1000;
+	if (chanpart->ch_deadline.tv_usec > 1000 * 1000)
+	{
+	    chanpart->ch_deadline.tv_usec -= 1000 * 1000;
+	    ++chanpart->ch_deadline.tv_sec;
+	}
+#endif
+	return FALSE;
     }
 
-    if (channel->ch_part[part].ch_mode == MODE_NL)
-    {
-	/* Drop any CR before a NL. */
-	p = node->rq_buffer;
-	for (i = 0; i < len; ++i)
-	    if (buf[i] != CAR || i + 1 >= len || buf[i + 1] != NL)
-		*p++ = buf[i];
-	*p = NUL;
-	node->rq_buflen = (long_u)(p - node->rq_buffer);
-    }
-    else
+#ifdef WIN32
+    timeout = GetTickCount() > chanpart->ch_deadline;
+#else
     {
-	mch_memmove(node->rq_buffer, buf, len);
-	node->rq_buffer[len] = NUL;
-	node->rq_buflen = (long_u)len;
-    }
+	struct timeval now_tv;
 
-    if (prepend)
-    {
-	/* preend node to the head of the queue */
-	node->rq_next = head->rq_next;
-	node->rq_prev = NULL;
-	if (head->rq_next == NULL)
-	    head->rq_prev = node;
-	else
-	    head->rq_next->rq_prev = node;
-	head->rq_next = node;
+	gettimeofday(&now_tv, NULL);
+	timeout = now_tv.tv_sec > chanpart->ch_deadline.tv_sec
+		  || (now_tv.tv_sec == chanpart->ch_deadline.tv_sec
+		       && now_tv.tv_usec > chanpart->ch_deadline.tv_usec);
     }
-    else
-    {
-	/* append node to the tail of the queue */
-	node->rq_next = NULL;
-	node->rq_prev = head->rq_prev;
-	if (head->rq_prev == NULL)
-	    head->rq_next = node;
-	else
-	    head->rq_prev->rq_next = node;
-	head->rq_prev = node;
-    }
-
-    if (ch_log_active() && lead != NULL)
+#endif
+    if (timeout)
     {
-	ch_log_lead(lead, channel);
-	fprintf(log_fd, "'");
-	ignored = (int)fwrite(buf, len, 1, log_fd);
-	fprintf(log_fd, "'\n");
+	chanpart->ch_wait_len = 0;
+	ch_log(channel, "timed out");
     }
-    return OK;
+    else
+	ch_log(channel, "still waiting on incomplete message");
+    return timeout;
 }
 
 /*
- * Try to fill the buffer of "reader".
- * Returns FALSE when nothing was added.
+ * Use the read buffer of "channel"/"part" in "msgpack" mode and decode a
+ * message that is complete.  The messages are added to the queue.
+ * A message that can't be decoded is dropped, the length says where the
+ * next one starts.  When the length is invalid, or the rest of a message
+ * doesn't arrive in time, all input is dropped.
+ * Return TRUE if there is more to read.
  */
     static int
-channel_fill(js_read_T *reader)
+channel_parse_msgpack(channel_T *channel, ch_part_T part)
 {
-    channel_T	*channel = (channel_T *)reader->js_cookie;
-    ch_part_T	part = reader->js_cookie_arg;
-    char_u	*next = channel_get(channel, part);
-    int		keeplen;
-    int		addlen;
-    char_u	*p;
+    chanpart_T	*chanpart = &channel->ch_part[part];
+    readq_T	*rq;
+    long_u	len = 0;
+    typval_T	listtv;
 
-    if (next == NULL)
+    rq = channel_peek(channel, part);
+    if (rq == NULL)
 	return FALSE;
-
-    keeplen = reader->js_end - reader->js_buf;
-    if (keeplen > 0)
+    if (rq->rq_buflen >= 4)
     {
-	/* Prepend unused text. */
-	addlen = (int)STRLEN(next);
-	p = alloc(keeplen + addlen + 1);
-	if (p == NULL)
+	len = msgpack_msg_len(rq->rq_buffer);
+	if (len > MSGPACK_MAX_LEN)
 	{
-	    vim_free(next);
+	    /* Can't tell where the next message starts. */
+	    ch_error(channel, "Message length %ld too long - discarding input",
+								  (long)len);
+	    chanpart->ch_wait_len = 0;
+	    channel_readq_free(channel, part);
 	    return FALSE;
 	}
-	mch_memmove(p, reader->js_buf, keeplen);
-	mch_memmove(p + keeplen, next, addlen + 1);
-	vim_free(next);
-	next = p;
     }
+    if (rq->rq_buflen < 4 || rq->rq_buflen - 4 < len)
+    {
+	/* Wait for the rest of the message, unless nothing more can arrive
+	 * because the fd was closed after a read error or end of file. */
+	if (chanpart->ch_fd != INVALID_FD
+		&& !channel_incomplete_timeout(channel, chanpart,
+						      (size_t)rq->rq_buflen))
+	    return FALSE;
+	ch_error(channel, "Incomplete message - discarding input");
+	chanpart->ch_wait_len = 0;
+	channel_readq_free(channel, part);
+	return FALSE;
+    }
+    chanpart->ch_wait_len = 0;
 
-    vim_free(reader->js_buf);
-    reader->js_buf = next;
-    return TRUE;
+    if (msgpack_decode(rq->rq_buffer + 4, len, &listtv) == OK)
+	channel_add_json_msg(channel, part, &listtv);
+    else
+	ch_error(channel, "Decoding failed - discarding message");
+    /* "len" is below MSGPACK_MAX_LEN, this does not overflow. */
+    channel_consume(channel, part, (int)len + 4);
+    return channel_peek(channel, part) != NULL;
 }
 
 /*
  * Use the read buffer of "channel"/"part" and parse a JSON message that is
  * complete.  The messages are added to the queue.
+ * The text is parsed where it is, a message may have been read in any number
+ * of pieces.  When the message is incomplete the part that was decoded is
+ * kept in ch_json_partial and consumed, the next call continues with what
+ * follows.
  * Return TRUE if there is more to read.
  */
     static int
@@ -1923,125 +2299,48 @@ channel_parse_json(channel_T *channel, ch_part_T part)
 {
     js_read_T	reader;
     typval_T	listtv;
-    jsonq_T	*item;
     chanpart_T	*chanpart = &channel->ch_part[part];
-    jsonq_T	*head = &chanpart->ch_json_head;
+    readq_T	*rq;
+    long_u	rq_buflen;
     int		status;
     int		ret;
 
-    if (channel_peek(channel, part) == NULL)
+    if (chanpart->ch_mode == MODE_MSGPACK)
+	return channel_parse_msgpack(channel, part);
+
+    /* When all text was decoded into an incomplete message still need to
+     * check the deadline. */
+    rq = channel_peek(channel, part);
+    if (rq == NULL && chanpart->ch_json_partial.jp_stack.ga_len == 0)
 	return FALSE;
+    rq_buflen = rq == NULL ? 0 : rq->rq_buflen;
 
-    reader.js_buf = channel_get(channel, part);
+    reader.js_buf = rq == NULL ? (char_u *)"" : rq->rq_buffer;
     reader.js_used = 0;
-    reader.js_fill = channel_fill;
-    reader.js_cookie = channel;
-    reader.js_cookie_arg = part;
+    reader.js_fill = NULL;
 
     /* When a message is incomplete we wait for a short while for more to
      * arrive.  After the delay drop the input, otherwise a truncated string
      * or list will make us hang.
      * Do not generate error messages, they will be written in a channel log. */
     ++emsg_silent;
-    status = json_decode(&reader, &listtv,
+    status = json_decode_partial(&reader, &chanpart->ch_json_partial, &listtv,
 				  chanpart->ch_mode == MODE_JS ? JSON_JS : 0);
     --emsg_silent;
     if (status == OK)
-    {
-	/* Only accept the response when it is a list with at least two
-	 * items. */
-	if (listtv.v_type != VAR_LIST || listtv.vval.v_list->lv_len < 2)
-	{
-	    if (listtv.v_type != VAR_LIST)
-		ch_error(channel, "Did not receive a list, discarding");
-	    else
-		ch_error(channel, "Expected list with two items, got %d",
-						  listtv.vval.v_list->lv_len);
-	    clear_tv(&listtv);
-	}
-	else
-	{
-	    item = (jsonq_T *)alloc((unsigned)sizeof(jsonq_T));
-	    if (item == NULL)
-		clear_tv(&listtv);
-	    else
-	    {
-		item->jq_no_callback = FALSE;
-		item->jq_value = alloc_tv();
-		if (item->jq_value == NULL)
-		{
-		    vim_free(item);
-		    clear_tv(&listtv);
-		}
-		else
-		{
-		    *item->jq_value = listtv;
-		    item->jq_prev = head->jq_prev;
-		    head->jq_prev = item;
-		    item->jq_next = NULL;
-		    if (item->jq_prev == NULL)
-			head->jq_next = item;
-		    else
-			item->jq_prev->jq_next = item;
-		}
-	    }
-	}
-    }
+	channel_add_json_msg(channel, part, &listtv);
 
     if (status == OK)
 	chanpart->ch_wait_len = 0;
     else if (status == MAYBE)
     {
-	size_t buflen = STRLEN(reader.js_buf);
+	/* Length of the incomplete message, including the part that was
+	 * already decoded. */
+	size_t buflen = chanpart->ch_json_partial.jp_used
+					       + rq_buflen - reader.js_used;
 
-	if (chanpart->ch_wait_len < buflen)
-	{
-	    /* First time encountering incomplete message or after receiving
-	     * more (but still incomplete): set a deadline of 100 msec. */
-	    ch_log(channel,
-		    "Incomplete message (%d bytes) - wait 100 msec for more",
-		    (int)buflen);
-	    reader.js_used = 0;
-	    chanpart->ch_wait_len = buflen;
-#ifdef WIN32
-	    chanpart->ch_deadline = GetTickCount() + 100L;
-#else
-	    gettimeofday(&chanpart->ch_deadline, NULL);
-	    chanpart->ch_deadline.tv_usec += 100 * 1000;
-	    if (chanpart->ch_deadline.tv_usec > 1000 * 1000)
-	    {
-		chanpart->ch_deadline.tv_usec -= 1000 * 1000;
-		++chanpart->ch_deadline.tv_sec;
-	    }
-#endif
-	}
-	else
-	{
-	    int timeout;
-#ifdef WIN32
-	    timeout = GetTickCount() > chanpart->ch_deadline;
-#else
-	    {
-		struct timeval now_tv;
-
-		gettimeofday(&now_tv, NULL);
-		timeout = now_tv.tv_sec > chanpart->ch_deadline.tv_sec
-		      || (now_tv.tv_sec == chanpart->ch_deadline.tv_sec
-			   && now_tv.tv_usec > chanpart->ch_deadline.tv_usec);
-	    }
-#endif
-	    if (timeout)
-	    {
-		status = FAIL;
-		chanpart->ch_wait_len = 0;
-		ch_log(channel, "timed out");
-	    }
-	    else
-	    {
-		reader.js_used = 0;
-		ch_log(channel, "still waiting on incomplete message");
-	    }
-	}
+	if (channel_incomplete_timeout(channel, chanpart, buflen))
+	    status = FAIL;
     }
 
     if (status == FAIL)
@@ -2049,19 +2348,23 @@ channel_parse_json(channel_T *channel, ch_part_T part)
 	ch_error(channel, "Decoding failed - discarding input");
 	ret = FALSE;
 	chanpart->ch_wait_len = 0;
+	json_partial_clear(&chanpart->ch_json_partial);
+	if (rq != NULL)
+	    channel_consume(channel, part, (int)rq_buflen);
     }
     else if (reader.js_buf[reader.js_used] != NUL)
     {
-	/* Put the unread part back into the channel. */
-	channel_save(channel, part, reader.js_buf + reader.js_used,
-			(int)(reader.js_end - reader.js_buf) - reader.js_used,
-								  TRUE, NULL);
+	/* Keep the unread part. */
+	channel_consume(channel, part, reader.js_used);
 	ret = status == MAYBE ? FALSE: TRUE;
     }
     else
+    {
 	ret = FALSE;
+	if (rq != NULL)
+	    channel_consume(channel, part, (int)rq_buflen);
+    }
 
-    vim_free(reader.js_buf);
     return ret;
 }
 
@@ -2203,6 +2506,28 @@ channel_push_json(channel_T *channel, ch_part_T part, typval_T *rettv)
 
 #define CH_JSON_MAX_ARGS 4
 
+/*
+ * Encode ["id", "val"] to be sent on a channel in mode "ch_mode", which is
+ * JSON, JS or MessagePack.  Returns allocated text and sets "*lenp" to its
+ * length.
+ * Returns NULL when out of memory or "val" cannot be encoded.
+ */
+    static char_u *
+channel_encode_nr_expr(ch_mode_T ch_mode, int id, typval_T *val, int *lenp)
+{
+    char_u	*text;
+
+    if (ch_mode == MODE_MSGPACK)
+	return msgpack_encode_nr_expr(id, val, lenp);
+    text = json_encode_nr_expr(id, val,
+				 (ch_mode == MODE_JS ? JSON_JS : 0) | JSON_NL);
+    if (text != NULL && *text == NUL)
+	VIM_CLEAR(text);
+    if (text != NULL)
+	*lenp = (int)STRLEN(text);
+    return text;
+}
+
 /*
  * Execute a command received over "channel"/"part"
  * "argv[0]" is the command string.
@@ -2213,7 +2538,7 @@ channel_exe_cmd(channel_T *channel, ch_part_T part, typval_T *argv)
 {
     char_u  *cmd = argv[0].vval.v_string;
     char_u  *arg;
-    int	    options = channel->ch_part[part].ch_mode == MODE_JS ? JSON_JS : 0;
+    ch_mode_T ch_mode = channel->ch_part[part].ch_mode;
 
     if (argv[1].v_type != VAR_STRING)
     {
@@ -2284,7 +2609,8 @@ channel_exe_cmd(channel_T *channel, ch_part_T part, typval_T *argv)
 	    typval_T	*tv = NULL;
 	    typval_T	res_tv;
 	    typval_T	err_tv;
-	    char_u	*json = NULL;
+	    char_u	*msg = NULL;
+	    int		len;
 
 	    /* Don't pollute the display with errors. */
 	    ++emsg_skip;
@@ -2305,22 +2631,21 @@ channel_exe_cmd(channel_T *channel, ch_part_T part, typval_T *argv)
 		int id = argv[id_idx].vval.v_number;
 
 		if (tv != NULL)
-		    json = json_encode_nr_expr(id, tv, options | JSON_NL);
-		if (tv == NULL || (json != NULL && *json == NUL))
+		    msg = channel_encode_nr_expr(ch_mode, id, tv, &len);
+		if (msg == NULL)
 		{
 		    /* If evaluation failed or the result can't be encoded
 		     * then return the string "ERROR". */
-		    vim_free(json);
 		    err_tv.v_type = VAR_STRING;
 		    err_tv.vval.v_string = (char_u *)"ERROR";
-		    json = json_encode_nr_expr(id, &err_tv, options | JSON_NL);
+		    msg = channel_encode_nr_expr(ch_mode, id, &err_tv, &len);
 		}
-		if (json != NULL)
+		if (msg != NULL)
 		{
 		    channel_send(channel,
 				 part == PART_SOCK ? PART_SOCK : PART_IN,
-				 json, (int)STRLEN(json), (char *)cmd);
-		    vim_free(json);
+				 msg, len, (char *)cmd);
+		    vim_free(msg);
 		}
 	    }
 	    --emsg_skip;
@@ -2358,8 +2683,17 @@ invoke_one_time_callback(
     vim_free(item);
 }
 
+/*
+ * Append "count" lines "lines" to "buffer" for "channel"/"part".
+ * Undo, marks and windows showing the buffer are updated once for all lines.
+ */
     static void
-append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
+append_to_buffer(
+	buf_T	    *buffer,
+	char_u	    **lines,
+	int	    count,
+	channel_T   *channel,
+	ch_part_T   part)
 {
     bufref_T	save_curbuf = {NULL, 0, 0};
     win_T	*save_curwin = NULL;
@@ -2369,6 +2703,7 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
     chanpart_T  *ch_part = &channel->ch_part[part];
     int		save_p_ma = buffer->b_p_ma;
     int		empty = (buffer->b_ml.ml_flags & ML_EMPTY) ? 1 : 0;
+    int		i;
 
     if (!buffer->b_p_ma && !ch_part->ch_nomodifiable)
     {
@@ -2389,7 +2724,11 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
     }
 
     /* Append to the buffer */
-    ch_log(channel, "appending line %d to buffer", (int)lnum + 1 - empty);
+    if (count == 1)
+	ch_log(channel, "appending line %d to buffer", (int)lnum + 1 - empty);
+    else
+	ch_log(channel, "appending lines %d to %d to buffer",
+			     (int)lnum + 1 - empty, (int)lnum + count - empty);
 
     buffer->b_p_ma = TRUE;
 
@@ -2400,15 +2739,16 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
     /* ignore undo failure, undo is not very useful here */
     ignored = u_save(lnum - empty, lnum + 1);
 
+    i = 0;
     if (empty)
     {
 	/* The buffer is empty, replace the first (dummy) line. */
-	ml_replace(lnum, msg, TRUE);
+	ml_replace(lnum, lines[i++], TRUE);
 	lnum = 0;
     }
-    else
-	ml_append(lnum, msg, 0, FALSE);
-    appended_lines_mark(lnum, 1L);
+    for ( ; i < count; ++i)
+	ml_append(lnum + i, lines[i], 0, FALSE);
+    appended_lines_mark(lnum, (long)count);
 
     /* Restore curbuf/curwin/curtab */
     restore_win_for_buf(save_curwin, save_curtab, &save_curbuf);
@@ -2424,13 +2764,17 @@ append_to_buffer(buf_T *buffer, char_u *msg, channel_T *channel, ch_part_T part)
 
 	FOR_ALL_WINDOWS(wp)
 	{
+	    /* When the cursor was in the last line move it to the new last
+	     * line.  In an empty buffer the first line replaces the dummy
+	     * line, the cursor follows the other lines. */
 	    if (wp->w_buffer == buffer
 		    && (save_write_to
 			? wp->w_cursor.lnum == lnum + 1
-			: (wp->w_cursor.lnum == lnum
+			: ((wp->w_cursor.lnum == lnum
+				|| (empty && count > 1 && wp->w_cursor.lnum == 1))
 			    && wp->w_cursor.col == 0)))
 	    {
-		++wp->w_cursor.lnum;
+		wp->w_cursor.lnum = lnum + count + (save_write_to ? 1 : 0);
 		save_curwin = curwin;
 		curwin = wp;
 		curbuf = curwin->w_buffer;
@@ -2472,6 +2816,164 @@ drop_messages(channel_T *channel, ch_part_T part)
     }
 }
 
+/*
+ * Get the next message ending in NL from "channel"/"part", without the NL.
+ * When the fd was closed also get the remaining text without a NL.
+ * Returns NULL when there is no complete message.  The caller must free the
+ * returned message.
+ */
+    static char_u *
+channel_get_nl(channel_T *channel, ch_part_T part)
+{
+    readq_T	*node = channel_peek(channel, part);
+    char_u	*nl;
+    char_u	*buf;
+    char_u	*p;
+    char_u	*msg;
+
+    if (node == NULL)
+	return NULL;
+
+    /* See if we have a message ending in NL. */
+    nl = channel_first_nl(node);
+    if (nl == NULL && channel->ch_part[part].ch_fd != INVALID_FD)
+	return NULL; /* incomplete message */
+    buf = node->rq_buffer;
+
+    if (nl == NULL)
+	/* Flush remaining message that is missing a NL, the text is
+	 * followed by a NUL. */
+	nl = buf + node->rq_buflen;
+
+    /* Convert NUL to NL, the internal representation. */
+    for (p = buf; p < nl; ++p)
+	if (*p == NUL)
+	    *p = NL;
+
+    /* Copy the message into allocated memory (excluding the NL) and
+     * remove it from the buffer (including the NL). */
+    msg = vim_strnsave(buf, (int)(nl - buf));
+    channel_consume(channel, part, nl < buf + node->rq_buflen
+					? (int)(nl - buf) + 1 : (int)(nl - buf));
+    return msg;
+}
+
+/*
+ * Append "msg" and the following NL messages that were already received to
+ * "buffer", up to APPEND_LINES_MAX lines at a time.
+ * Only to be used when there is no callback for the messages.
+ */
+    static void
+append_nl_to_buffer(
+	buf_T	    *buffer,
+	char_u	    *msg,
+	channel_T   *channel,
+	ch_part_T   part)
+{
+    garray_T	ga;
+    char_u	*line;
+    int		i;
+
+    ga_init2(&ga, (int)sizeof(char_u *), 100);
+    if (ga_grow(&ga, 1) == FAIL)
+    {
+	append_to_buffer(buffer, &msg, 1, channel, part);
+	return;
+    }
+    ((char_u **)ga.ga_data)[ga.ga_len++] = msg;
+    while (ga.ga_len < APPEND_LINES_MAX && ga_grow(&ga, 1) == OK
+			  && (line = channel_get_nl(channel, part)) != NULL)
+	((char_u **)ga.ga_data)[ga.ga_len++] = line;
+
+    append_to_buffer(buffer, (char_u **)ga.ga_data, ga.ga_len, channel, part);
+
+    /* "msg" is freed by the caller */
+    for (i = 1; i < ga.ga_len; ++i)
+	vim_free(((char_u **)ga.ga_data)[i]);
+    ga_clear(&ga);
+}
+
+/*
+ * Invoke "callback" for "channel"/"part" with a list of messages: "argv[1]"
+ * and further messages that were already received, up to the "batch" option.
+ * Only messages that are not a command and are not for a specific request
+ * are added.
+ */
+    static void
+invoke_batch_callback(
+	channel_T   *channel,
+	ch_part_T   part,
+	char_u	    *callback,
+	partial_T   *partial,
+	typval_T    *argv)
+{
+    chanpart_T	*ch_part = &channel->ch_part[part];
+    ch_mode_T	ch_mode = ch_part->ch_mode;
+    jsonq_T	*head = &ch_part->ch_json_head;
+    list_T	*l;
+    typval_T	tv;
+
+    l = list_alloc();
+    if (l == NULL)
+	return;  /* out of memory! */
+    ++l->lv_refcount;
+    if (argv[1].v_type == VAR_UNKNOWN)
+    {
+	tv.v_type = VAR_SPECIAL;
+	tv.vval.v_number = VVAL_NONE;
+	list_append_tv(l, &tv);
+    }
+    else
+	list_append_tv(l, &argv[1]);
+
+    while (l->lv_len < ch_part->ch_batch)
+    {
+	if (ch_mode == MODE_NL)
+	{
+	    char_u *msg = channel_get_nl(channel, part);
+
+	    if (msg == NULL)
+		break;
+	    list_append_string(l, msg, -1);
+	    vim_free(msg);
+	}
+	else
+	{
+	    jsonq_T	*item = head->jq_next;
+	    listitem_T	*li;
+
+	    if (item == NULL)
+	    {
+		/* Decode the next message from the readahead. */
+		channel_parse_json(channel, part);
+		item = head->jq_next;
+	    }
+	    if (item == NULL || item->jq_no_callback)
+		break;
+	    li = item->jq_value->vval.v_list->lv_first;
+	    if (li->li_tv.v_type != VAR_NUMBER || li->li_tv.vval.v_number != 0)
+		break;
+	    if (li->li_next == NULL)
+	    {
+		tv.v_type = VAR_SPECIAL;
+		tv.vval.v_number = VVAL_NONE;
+		list_append_tv(l, &tv);
+	    }
+	    else
+		list_append_tv(l, &li->li_next->li_tv);
+	    free_tv(item->jq_value);
+	    remove_json_node(head, item);
+	}
+    }
+
+    ch_log(channel, "Invoking channel callback %s with %d messages",
+						 (char *)callback, l->lv_len);
+    argv[1].v_type = VAR_LIST;
+    argv[1].vval.v_list = l;
+    invoke_callback(channel, callback, partial, argv);
+    list_unref(l);
+}
+
 /*
  * Invoke a callback for "channel"/"part" if needed.
  * This does not redraw but sets channel_need_redraw when redraw is needed.
@@ -2491,7 +2993,6 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
     char_u	*callback = NULL;
     partial_T	*partial = NULL;
     buf_T	*buffer = NULL;
-    char_u	*p;
 
     if (channel->ch_nb_close_cb != NULL)
 	/* this channel is handled elsewhere (netbeans) */
@@ -2527,7 +3028,7 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	buffer = NULL;
     }
 
-    if (ch_mode == MODE_JSON || ch_mode == MODE_JS)
+    if (ch_mode == MODE_JSON || ch_mode == MODE_JS || ch_mode == MODE_MSGPACK)
     {
 	listitem_T	*item;
 	int		argc = 0;
@@ -2578,67 +3079,15 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	    /* If there is a close callback it may use ch_read() to get the
 	     * messages. */
 	    if (channel->ch_close_cb == NULL && !channel->ch_drop_never)
-		drop_messages(channel, part);
-	    return FALSE;
-	}
-
-	if (ch_mode == MODE_NL)
-	{
-	    char_u  *nl = NULL;
-	    char_u  *buf;
-	    readq_T *node;
-
-	    /* See if we have a message ending in NL in the first buffer.  If
-	     * not try to concatenate the first and the second buffer. */
-	    while (TRUE)
-	    {
-		node = channel_peek(channel, part);
-		nl = channel_first_nl(node);
-		if (nl != NULL)
-		    break;
-		if (channel_collapse(channel, part, TRUE) == FAIL)
-		{
-		    if (ch_part->ch_fd == INVALID_FD && node->rq_buflen > 0)
-			break;
-		    return FALSE; /* incomplete message */
-		}
-	    }
-	    buf = node->rq_buffer;
-
-	    if (nl == NULL)
-	    {
-		/* Flush remaining message that is missing a NL. */
-		char_u	*new_buf;
-
-		new_buf = vim_realloc(buf, node->rq_buflen + 1);
-		if (new_buf == NULL)
-		    /* This might fail over and over again, should the message
-		     * be dropped? */
-		    return FALSE;
-		buf = new_buf;
-		node->rq_buffer = buf;
-		nl = buf + node->rq_buflen++;
-		*nl = NUL;
-	    }
-
-	    /* Convert NUL to NL, the internal representation. */
-	    for (p = buf; p < nl && p < buf + node->rq_buflen; ++p)
-		if (*p == NUL)
-		    *p = NL;
+		drop_messages(channel, part);
+	    return FALSE;
+	}
 
-	    if (nl + 1 == buf + node->rq_buflen)
-	    {
-		/* get the whole buffer, drop the NL */
-		msg = channel_get(channel, part);
-		*nl = NUL;
-	    }
-	    else
-	    {
-		/* Copy the message into allocated memory (excluding the NL)
-		 * and remove it from the buffer (including the NL). */
-		msg = vim_strnsave(buf, (int)(nl - buf));
-		channel_consume(channel, part, (int)(nl - buf) + 1);
-	    }
+	if (ch_mode == MODE_NL)
+	{
+	    msg = channel_get_nl(channel, part);
+	    if (msg == NULL)
+		return FALSE; /* incomplete message */
 	}
 	else
 	{
@@ -2685,8 +3134,9 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	if (buffer != NULL)
 	{
 	    if (msg == NULL)
-		/* JSON or JS mode: re-encode the message. */
-		msg = json_encode(listtv, ch_mode);
+		/* JSON, JS or msgpack mode: re-encode the message, as JSON
+		 * for msgpack. */
+		msg = json_encode(listtv, ch_mode == MODE_MSGPACK ? 0 : ch_mode);
 	    if (msg != NULL)
 	    {
 #ifdef FEAT_TERMINAL
@@ -2694,7 +3144,10 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 		    write_to_term(buffer, msg, channel);
 		else
 #endif
-		    append_to_buffer(buffer, msg, channel, part);
+		if (ch_mode == MODE_NL && callback == NULL)
+		    append_nl_to_buffer(buffer, msg, channel, part);
+		else
+		    append_to_buffer(buffer, &msg, 1, channel, part);
 	    }
 	}
 
@@ -2702,6 +3155,9 @@ may_invoke_callback(channel_T *channel, ch_part_T part)
 	{
 	    if (cbitem != NULL)
 		invoke_one_time_callback(channel, cbhead, cbitem, argv);
+	    else if (ch_part->ch_batch > 0 && buffer == NULL
+						       && ch_mode != MODE_RAW)
+		invoke_batch_callback(channel, part, callback, partial, argv);
 	    else
 	    {
 		/* invoke the channel callback */
@@ -2753,12 +3209,15 @@ channel_has_readahead(channel_T *channel, ch_part_T part)
 {
     ch_mode_T	ch_mode = channel->ch_part[part].ch_mode;
 
-    if (ch_mode == MODE_JSON || ch_mode == MODE_JS)
+    if (ch_mode == MODE_JSON || ch_mode == MODE_JS || ch_mode == MODE_MSGPACK)
     {
 	jsonq_T   *head = &channel->ch_part[part].ch_json_head;
 	jsonq_T   *item = head->jq_next;
 
-	return item != NULL;
+	/* Text is decoded when a message is needed.  After the fd was closed
+	 * what is left must still be decoded. */
+	return item != NULL || (channel->ch_part[part].ch_fd == INVALID_FD
+				       && channel_peek(channel, part) != NULL);
     }
     return channel_peek(channel, part) != NULL;
 }
@@ -2835,6 +3294,7 @@ channel_part_info(channel_T *channel, dict_T *dict, char *name, ch_part_T part)
 	case MODE_RAW: s = "RAW"; break;
 	case MODE_JSON: s = "JSON"; break;
 	case MODE_JS: s = "JS"; break;
+	case MODE_MSGPACK: s = "MSGPACK"; break;
     }
     dict_add_nr_str(dict, namebuf, 0, (char_u *)s);
 
@@ -2853,6 +3313,13 @@ channel_part_info(channel_T *channel, dict_T *dict, char *name, ch_part_T part)
 
     STRCPY(namebuf + tail, "timeout");
     dict_add_nr_str(dict, namebuf, chanpart->ch_timeout, NULL);
+
+    if (part == PART_SOCK || part == PART_IN)
+    {
+	STRCPY(namebuf + tail, "queued");
+	dict_add_nr_str(dict, namebuf, (varnumber_T)chanpart->ch_write_queued,
+									NULL);
+    }
 }
 
     void
@@ -2971,12 +3438,25 @@ channel_close(channel_T *channel, int invoke_close_cb)
     void
 channel_close_in(channel_T *channel)
 {
-    ch_close_part(channel, PART_IN);
+    chanpart_T *in_part = &channel->ch_part[PART_IN];
+
+    if (in_part->ch_writeque.wq_next != NULL)
+    {
+	/* Do not drop what was written but is still queued, close when the
+	 * queue is empty, see channel_write_input(). */
+	ch_log(channel, "Closing in part when the write queue is empty");
+	in_part->ch_close_written = TRUE;
+    }
+    else
+	ch_close_part(channel, PART_IN);
 }
 
     static void
-remove_from_writeque(writeq_T *wq, writeq_T *entry)
+remove_from_writeque(chanpart_T *ch_part, writeq_T *entry)
 {
+    writeq_T *wq = &ch_part->ch_writeque;
+
+    ch_part->ch_write_queued -= entry->wq_ga.ga_len;
     ga_clear(&entry->wq_ga);
     wq->wq_next = entry->wq_next;
     if (wq->wq_next == NULL)
@@ -2986,6 +3466,118 @@ remove_from_writeque(writeq_T *wq, writeq_T *entry)
     vim_free(entry);
 }
 
+/*
+ * Append "len" bytes of "buf" to the write queue of "ch_part".  Entries are
+ * kept at WRITEQ_ENTRY_SIZE bytes or less, so that removing what was
+ * written from the first entry doesn't move much data.
+ */
+    static void
+add_to_writeque(chanpart_T *ch_part, char_u *buf, int len)
+{
+    writeq_T *wq = &ch_part->ch_writeque;
+
+    while (len > 0)
+    {
+	writeq_T    *last = wq->wq_prev;
+	int	    n;
+
+	if (last == NULL || last->wq_ga.ga_len >= WRITEQ_ENTRY_SIZE)
+	{
+	    last = (writeq_T *)alloc((int)sizeof(writeq_T));
+	    if (last == NULL)
+		return;  /* out of memory! */
+	    last->wq_prev = wq->wq_prev;
+	    last->wq_next = NULL;
+	    if (wq->wq_prev == NULL)
+		wq->wq_next = last;
+	    else
+		wq->wq_prev->wq_next = last;
+	    wq->wq_prev = last;
+	    ga_init2(&last->wq_ga, 1, 1000);
+	}
+
+	n = WRITEQ_ENTRY_SIZE - last->wq_ga.ga_len;
+	if (n > len)
+	    n = len;
+	if (ga_grow(&last->wq_ga, n) == FAIL)
+	    return;  /* out of memory! */
+	mch_memmove((char *)last->wq_ga.ga_data + last->wq_ga.ga_len, buf, n);
+	last->wq_ga.ga_len += n;
+	ch_part->ch_write_queued += n;
+	buf += n;
+	len -= n;
+    }
+}
+
+/*
+ * Return the number of bytes queued for writing on "channel".
+ */
+    static long_u
+channel_write_queued(channel_T *channel)
+{
+    return channel->ch_part[PART_SOCK].ch_write_queued
+				   + channel->ch_part[PART_IN].ch_write_queued;
+}
+
+/*
+ * Drop what is queued for writing on "channel"/"part".
+ */
+    static void
+channel_clear_writeque(channel_T *channel, ch_part_T part)
+{
+    chanpart_T *ch_part = &channel->ch_part[part];
+
+    while (ch_part->ch_writeque.wq_next != NULL)
+	remove_from_writeque(ch_part, ch_part->ch_writeque.wq_next);
+    ch_part->ch_close_written = FALSE;
+
+    /* Dropping what was queued does not invoke the drain callback. */
+    if (channel->ch_write_full
+	    && channel_write_queued(channel) <= (long_u)channel->ch_write_low)
+	channel->ch_write_full = FALSE;
+}
+
+/*
+ * Check the number of bytes queued for writing on "channel" against the
+ * "write_high" and "write_low" limits.  When the queue has drained to
+ * "write_low" after going over "write_high" the drain callback is invoked
+ * from channel_parse_messages().
+ */
+    static void
+channel_check_watermark(channel_T *channel)
+{
+    long_u queued = channel_write_queued(channel);
+
+    if (!channel->ch_write_full)
+    {
+	if (queued > (long_u)channel->ch_write_high)
+	{
+	    ch_log(channel, "Write queue has %ld bytes, above write_high",
+								(long)queued);
+	    channel->ch_write_full = TRUE;
+	}
+    }
+    else if (queued <= (long_u)channel->ch_write_low)
+    {
+	ch_log(channel, "Write queue drained");
+	channel->ch_write_full = FALSE;
+	if (channel->ch_drain_cb != NULL)
+	    channel->ch_drain_pending = TRUE;
+    }
+}
+
+/*
+ * Return TRUE when "channel" is open for writing and the write queue is not
+ * above the "write_high" limit.
+ */
+    int
+channel_writable(channel_T *channel)
+{
+    return channel != NULL
+	&& channel->ch_part[channel_part_send(channel)].ch_fd != INVALID_FD
+	&& !channel->ch_write_full;
+}
+
 /*
  * Clear the read buffer on "channel"/"part".
  */
@@ -2996,8 +3588,8 @@ channel_clear_one(channel_T *channel, ch_part_T part)
     jsonq_T *json_head = &ch_part->ch_json_head;
     cbq_T   *cb_head = &ch_part->ch_cb_head;
 
-    while (channel_peek(channel, part) != NULL)
-	vim_free(channel_get(channel, part));
+    channel_readq_free(channel, part);
+    json_partial_clear(&ch_part->ch_json_partial);
 
     while (cb_head->cq_next != NULL)
     {
@@ -3018,9 +3610,7 @@ channel_clear_one(channel_T *channel, ch_part_T part)
     ch_part->ch_callback = NULL;
     ch_part->ch_partial = NULL;
 
-    while (ch_part->ch_writeque.wq_next != NULL)
-	remove_from_writeque(&ch_part->ch_writeque,
-						 ch_part->ch_writeque.wq_next);
+    channel_clear_writeque(channel, part);
 }
 
 /*
@@ -3041,6 +3631,9 @@ channel_clear(channel_T *channel)
     free_callback(channel->ch_close_cb, channel->ch_close_partial);
     channel->ch_close_cb = NULL;
     channel->ch_close_partial = NULL;
+    free_callback(channel->ch_drain_cb, channel->ch_drain_partial);
+    channel->ch_drain_cb = NULL;
+    channel->ch_drain_partial = NULL;
 }
 
 #if defined(EXITFREE) || defined(PROTO)
@@ -3052,6 +3645,9 @@ channel_free_all(void)
     ch_log(NULL, "channel_free_all()");
     for (channel = first_channel; channel != NULL; channel = channel->ch_next)
 	channel_clear(channel);
+# ifdef UNIX
+    VIM_CLEAR(read_extra);
+# endif
 }
 #endif
 
@@ -3059,9 +3655,6 @@ channel_free_all(void)
 /* Sent when the netbeans channel is found closed when reading. */
 #define DETACH_MSG_RAW "DETACH\n"
 
-/* Buffer size for reading incoming messages. */
-#define MAXMSGSIZE 4096
-
 #if defined(HAVE_SELECT)
 /*
  * Add write fds where we are waiting for writing to be possible.
@@ -3074,8 +3667,16 @@ channel_fill_wfds(int maxfd_arg, fd_set *wfds)
 
     for (ch = first_channel; ch != NULL; ch = ch->ch_next)
     {
+	chanpart_T  *sock_part = &ch->ch_part[PART_SOCK];
 	chanpart_T  *in_part = &ch->ch_part[PART_IN];
 
+	if (sock_part->ch_fd != INVALID_FD
+				      && sock_part->ch_writeque.wq_next != NULL)
+	{
+	    FD_SET((int)sock_part->ch_fd, wfds);
+	    if ((int)sock_part->ch_fd >= maxfd)
+		maxfd = (int)sock_part->ch_fd + 1;
+	}
 	if (in_part->ch_fd != INVALID_FD
 		&& (in_part->ch_bufref.br_buf != NULL
 		    || in_part->ch_writeque.wq_next != NULL))
@@ -3228,6 +3829,9 @@ channel_wait(channel_T *channel, sock_T fd, int timeout)
 
 	    fds[0].fd = fd;
 	    fds[0].events = POLLIN;
+	    if (fd == channel->CH_SOCK_FD
+		    && channel->ch_part[PART_SOCK].ch_writeque.wq_next != NULL)
+		fds[0].events |= POLLOUT;
 	    nfd = channel_fill_poll_write(nfd, fds);
 	    if (poll(fds, nfd, timeout) > 0)
 	    {
@@ -3268,7 +3872,7 @@ ch_close_part_on_error(
      */
     if (channel->ch_nb_close_cb != NULL)
 	channel_save(channel, PART_SOCK, (char_u *)DETACH_MSG_RAW,
-			      (int)STRLEN(DETACH_MSG_RAW), FALSE, "PUT ");
+				     (int)STRLEN(DETACH_MSG_RAW), "PUT ");
 
     /* When reading is not possible close this part of the channel.  Don't
      * close the channel yet, there may be something to read on another part. */
@@ -3297,11 +3901,16 @@ channel_close_now(channel_T *channel)
     static void
 channel_read(channel_T *channel, ch_part_T part, char *func)
 {
-    static char_u	*buf = NULL;
+    char_u		*buf;
+    long_u		room;
     int			len = 0;
     int			readlen = 0;
     sock_T		fd;
-    int			use_socket = FALSE;
+#ifdef UNIX
+    struct iovec	iov[2];
+#else
+    int			use_socket;
+#endif
 
     fd = channel->ch_part[part].ch_fd;
     if (fd == INVALID_FD)
@@ -3310,33 +3919,64 @@ channel_read(channel_T *channel, ch_part_T part, char *func)
 							    part_names[part]);
 	return;
     }
-    use_socket = fd == channel->CH_SOCK_FD;
 
-    /* Allocate a buffer to read into. */
-    if (buf == NULL)
+#ifdef UNIX
+    /* Allocate a buffer for what doesn't fit in the read buffer. */
+    if (read_extra == NULL)
     {
-	buf = alloc(MAXMSGSIZE);
-	if (buf == NULL)
+	read_extra = alloc(READ_EXTRA_SIZE);
+	if (read_extra == NULL)
 	    return;	/* out of memory! */
     }
+#else
+    use_socket = fd == channel->CH_SOCK_FD;
+#endif
 
     /* Keep on reading for as long as there is something to read.
-     * Use select() or poll() to avoid blocking on a message that is exactly
-     * MAXMSGSIZE long. */
+     * Use select() or poll() to avoid blocking on a message that exactly
+     * fills the space. */
     for (;;)
     {
 	if (channel_wait(channel, fd, 0) != CW_READY)
 	    break;
+
+	/* Read directly into the free space of the read buffer. */
+	buf = channel_readq_space(channel, part, MAXMSGSIZE);
+	if (buf == NULL)
+	    break;	/* out of memory! */
+	room = channel->ch_part[part].ch_readq.rq_size - 1
+			 - (buf - channel->ch_part[part].ch_readq.rq_alloc);
+#ifdef UNIX
+	/* What doesn't fit goes into "read_extra", so that one system call
+	 * gets everything that is available without growing the buffer
+	 * first. */
+	iov[0].iov_base = buf;
+	iov[0].iov_len = room;
+	iov[1].iov_base = read_extra;
+	iov[1].iov_len = READ_EXTRA_SIZE;
+	len = readv(fd, iov, 2);
+	if (len <= 0)
+	    break;	/* error or nothing more to read */
+
+	if ((long_u)len <= room)
+	    channel_readq_added(channel, part, buf, (long_u)len, "RECV ");
+	else
+	{
+	    channel_readq_added(channel, part, buf, room, "RECV ");
+	    channel_save(channel, part, read_extra, len - (int)room, "RECV ");
+	}
+	readlen += len;
+#else
 	if (use_socket)
-	    len = sock_read(fd, (char *)buf, MAXMSGSIZE);
+	    len = sock_read(fd, (char *)buf, (int)room);
 	else
-	    len = fd_read(fd, (char *)buf, MAXMSGSIZE);
+	    len = fd_read(fd, (char *)buf, room);
 	if (len <= 0)
 	    break;	/* error or nothing more to read */
 
-	/* Store the read message in the queue. */
-	channel_save(channel, part, buf, len, FALSE, "RECV ");
+	channel_readq_added(channel, part, buf, (long_u)len, "RECV ");
 	readlen += len;
+#endif
 	if (len < MAXMSGSIZE)
 	    break;	/* did read everything that's available */
     }
@@ -3383,8 +4023,6 @@ channel_read_block(channel_T *channel, ch_part_T part, int timeout, int raw)
 					   && channel_first_nl(node) != NULL))
 		/* got a complete message */
 		break;
-	    if (channel_collapse(channel, part, mode == MODE_NL) == OK)
-		continue;
 	    /* If not blocking or nothing more is coming then return what we
 	     * have. */
 	    if (raw || fd == INVALID_FD)
@@ -3424,12 +4062,6 @@ channel_read_block(channel_T *channel, ch_part_T part, int timeout, int raw)
 	    /* must be a closed channel with missing NL */
 	    msg = channel_get(channel, part);
 	}
-	else if (nl + 1 == buf + node->rq_buflen)
-	{
-	    /* get the whole buffer */
-	    msg = channel_get(channel, part);
-	    *nl = NUL;
-	}
 	else
 	{
 	    /* Copy the message into allocated memory and remove it from the
@@ -3712,6 +4344,8 @@ channel_set_nonblock(channel_T *channel, ch_part_T part)
 
 /*
  * Write "buf" (NUL terminated string) to "channel"/"part".
+ * When the fd is non-blocking what can't be written now is added to the write
+ * queue, which is written when the fd is writable, see channel_write_input().
  * When "fun" is not NULL an error message might be given.
  * Return FAIL or OK.
  */
@@ -3726,6 +4360,9 @@ channel_send(
     int		res;
     sock_T	fd;
     chanpart_T	*ch_part = &channel->ch_part[part];
+    writeq_T	*wq = &ch_part->ch_writeque;
+    char_u	*rest = buf_arg;
+    int		rest_len = len_arg;
     int		did_use_queue = FALSE;
 
     fd = ch_part->ch_fd;
@@ -3750,26 +4387,54 @@ channel_send(
 	did_log_msg = TRUE;
     }
 
-    for (;;)
+    /* What is queued is written first, "rest" is what remains of the
+     * argument.  Nothing to write happens when called from
+     * channel_write_input(). */
+    while (wq->wq_next != NULL || rest_len > 0)
     {
-	writeq_T    *wq = &ch_part->ch_writeque;
-	char_u	    *buf;
-	int	    len;
+	int	    len = 0;
+	int	    queued = 0;   /* part of "len" that comes from the queue */
+#ifdef UNIX
+	struct iovec	iov[WRITEQ_IOV_MAX + 1];
+	int		iovcnt = 0;
+	writeq_T	*entry;
+
+	/* Write queued entries and, when they all fit, the argument with one
+	 * system call. */
+	for (entry = wq->wq_next; entry != NULL && iovcnt < WRITEQ_IOV_MAX;
+							 entry = entry->wq_next)
+	{
+	    iov[iovcnt].iov_base = entry->wq_ga.ga_data;
+	    iov[iovcnt].iov_len = entry->wq_ga.ga_len;
+	    queued += entry->wq_ga.ga_len;
+	    ++iovcnt;
+	}
+	len = queued;
+	if (entry == NULL && rest_len > 0)
+	{
+	    iov[iovcnt].iov_base = rest;
+	    iov[iovcnt].iov_len = rest_len;
+	    len += rest_len;
+	    ++iovcnt;
+	}
+	if (queued > 0)
+	    did_use_queue = TRUE;
+	res = writev(fd, iov, iovcnt);
+#else
+	char_u	*buf;
 
 	if (wq->wq_next != NULL)
 	{
 	    /* first write what was queued */
 	    buf = wq->wq_next->wq_ga.ga_data;
 	    len = wq->wq_next->wq_ga.ga_len;
+	    queued = len;
 	    did_use_queue = TRUE;
 	}
 	else
 	{
-	    if (len_arg == 0)
-		/* nothing to write, called from channel_select_check() */
-		return OK;
-	    buf = buf_arg;
-	    len = len_arg;
+	    buf = rest;
+	    len = rest_len;
 	}
 
 	if (part == PART_SOCK)
@@ -3777,15 +4442,15 @@ channel_send(
 	else
 	{
 	    res = fd_write(fd, (char *)buf, len);
-#ifdef WIN32
+# ifdef WIN32
 	    if (channel->ch_named_pipe && res < 0)
 	    {
 		DisconnectNamedPipe((HANDLE)fd);
 		ConnectNamedPipe((HANDLE)fd, NULL);
 	    }
-#endif
-
+# endif
 	}
+#endif
 	if (res < 0 && (errno == EWOULDBLOCK
 #ifdef EAGAIN
 			|| errno == EAGAIN
@@ -3793,87 +4458,54 @@ channel_send(
 		    ))
 	    res = 0; /* nothing got written */
 
-	if (res >= 0 && ch_part->ch_nonblocking)
+	if (res >= 0 && (ch_part->ch_nonblocking || res == len))
 	{
-	    writeq_T *entry = wq->wq_next;
+	    int	    done = res < queued ? res : queued;
 
 	    if (did_use_queue)
 		ch_log(channel, "Sent %d bytes now", res);
-	    if (res == len)
-	    {
-		/* Wrote all the buf[len] bytes. */
-		if (entry != NULL)
-		{
-		    /* Remove the entry from the write queue. */
-		    remove_from_writeque(wq, entry);
-		    continue;
-		}
-		if (did_use_queue)
-		    ch_log(channel, "Write queue empty");
-	    }
-	    else
+
+	    /* Remove the bytes that were written from the queue. */
+	    while (done > 0)
 	    {
-		/* Wrote only buf[res] bytes, can't write more now. */
-		if (entry != NULL)
+		writeq_T *first = wq->wq_next;
+
+		if (done >= first->wq_ga.ga_len)
 		{
-		    if (res > 0)
-		    {
-			/* Remove the bytes that were written. */
-			mch_memmove(entry->wq_ga.ga_data,
-				    (char *)entry->wq_ga.ga_data + res,
-				    len - res);
-			entry->wq_ga.ga_len -= res;
-		    }
-		    buf = buf_arg;
-		    len = len_arg;
+		    done -= first->wq_ga.ga_len;
+		    remove_from_writeque(ch_part, first);
 		}
 		else
 		{
-		    buf += res;
-		    len -= res;
+		    mch_memmove(first->wq_ga.ga_data,
+				(char *)first->wq_ga.ga_data + done,
+				first->wq_ga.ga_len - done);
+		    first->wq_ga.ga_len -= done;
+		    ch_part->ch_write_queued -= done;
+		    done = 0;
 		}
-		ch_log(channel, "Adding %d bytes to the write queue", len);
-
-		/* Append the not written bytes of the argument to the write
-		 * buffer.  Limit entries to 4000 bytes. */
-		if (wq->wq_prev != NULL
-			&& wq->wq_prev->wq_ga.ga_len + len < 4000)
-		{
-		    writeq_T *last = wq->wq_prev;
+	    }
+	    if (res > queued)
+	    {
+		rest += res - queued;
+		rest_len -= res - queued;
+	    }
 
-		    /* append to the last entry */
-		    if (ga_grow(&last->wq_ga, len) == OK)
-		    {
-			mch_memmove((char *)last->wq_ga.ga_data
-							  + last->wq_ga.ga_len,
-				    buf, len);
-			last->wq_ga.ga_len += len;
-		    }
-		}
-		else
+	    if (res < len)
+	    {
+		/* Can't write more now, queue the rest of the argument. */
+		if (rest_len > 0)
 		{
-		    writeq_T *last = (writeq_T *)alloc((int)sizeof(writeq_T));
-
-		    if (last != NULL)
-		    {
-			last->wq_prev = wq->wq_prev;
-			last->wq_next = NULL;
-			if (wq->wq_prev == NULL)
-			    wq->wq_next = last;
-			else
-			    wq->wq_prev->wq_next = last;
-			wq->wq_prev = last;
-			ga_init2(&last->wq_ga, 1, 1000);
-			if (ga_grow(&last->wq_ga, len) == OK)
-			{
-			    mch_memmove(last->wq_ga.ga_data, buf, len);
-			    last->wq_ga.ga_len = len;
-			}
-		    }
+		    ch_log(channel, "Adding %d bytes to the write queue",
+								     rest_len);
+		    add_to_writeque(ch_part, rest, rest_len);
 		}
+		break;
 	    }
+	    if (did_use_queue && wq->wq_next == NULL)
+		ch_log(channel, "Write queue empty");
 	}
-	else if (res != len)
+	else
 	{
 	    if (!channel->ch_error && fun != NULL)
 	    {
@@ -3883,10 +4515,15 @@ channel_send(
 	    channel->ch_error = TRUE;
 	    return FAIL;
 	}
-
-	channel->ch_error = FALSE;
-	return OK;
     }
+
+    channel->ch_error = FALSE;
+#ifdef HAVE_EPOLL
+    if (wq->wq_next != NULL || did_use_queue)
+	channel_epoll_update(channel);
+#endif
+    channel_check_watermark(channel);
+    return OK;
 }
 
 /*
@@ -3899,6 +4536,7 @@ channel_send(
 send_common(
 	typval_T    *argvars,
 	char_u	    *text,
+	int	    len,
 	int	    id,
 	int	    eval,
 	jobopt_T    *opt,
@@ -3932,7 +4570,7 @@ send_common(
 				       opt->jo_callback, opt->jo_partial, id);
     }
 
-    if (channel_send(channel, part_send, text, (int)STRLEN(text), fun) == OK
+    if (channel_send(channel, part_send, text, len, fun) == OK
 						  && opt->jo_callback == NULL)
 	return channel;
     return NULL;
@@ -3953,6 +4591,7 @@ ch_expr_common(typval_T *argvars, typval_T *rettv, int eval)
     ch_part_T	part_read;
     jobopt_T    opt;
     int		timeout;
+    int		len;
 
     /* return an empty string by default */
     rettv->v_type = VAR_STRING;
@@ -3971,12 +4610,11 @@ ch_expr_common(typval_T *argvars, typval_T *rettv, int eval)
     }
 
     id = ++channel->ch_last_msg_id;
-    text = json_encode_nr_expr(id, &argvars[1],
-				 (ch_mode == MODE_JS ? JSON_JS : 0) | JSON_NL);
+    text = channel_encode_nr_expr(ch_mode, id, &argvars[1], &len);
     if (text == NULL)
 	return;
 
-    channel = send_common(argvars, text, id, eval, &opt,
+    channel = send_common(argvars, text, len, id, eval, &opt,
 			    eval ? "ch_evalexpr" : "ch_sendexpr", &part_read);
     vim_free(text);
     if (channel != NULL && eval)
@@ -4018,7 +4656,7 @@ ch_raw_common(typval_T *argvars, typval_T *rettv, int eval)
     rettv->vval.v_string = NULL;
 
     text = get_tv_string_buf(&argvars[1], buf);
-    channel = send_common(argvars, text, 0, eval, &opt,
+    channel = send_common(argvars, text, (int)STRLEN(text), 0, eval, &opt,
 			      eval ? "ch_evalraw" : "ch_sendraw", &part_read);
     if (channel != NULL && eval)
     {
@@ -4034,7 +4672,78 @@ ch_raw_common(typval_T *argvars, typval_T *rettv, int eval)
 
 # define KEEP_OPEN_TIME 20  /* msec */
 
+# ifdef HAVE_EPOLL
+/* Maximum number of ready fds handled for one epoll_wait(). */
+#  define CH_EPOLL_EVENTS 32
+
+/*
+ * Read from and write to the channels that epoll says are ready, without
+ * waiting.  Also read from keep-open channels, since these are polled.
+ */
+    static void
+channel_epoll_check(int ready, char *func)
+{
+    struct epoll_event	events[CH_EPOLL_EVENTS];
+    int			n = 0;
+    int			i;
+
+    if (ready)
+	n = epoll_wait(channel_epoll_fd, events, CH_EPOLL_EVENTS, 0);
+    for (i = 0; i < n; ++i)
+    {
+	int		fd = events[i].data.fd;
+	int		revents = events[i].events;
+	ch_epoll_T	*ce;
+	channel_T	*channel;
+	ch_part_T	part;
+
+	/* Handling a previous fd may have closed this one. */
+	if (fd >= channel_epoll_ga.ga_len)
+	    continue;
+	ce = (ch_epoll_T *)channel_epoll_ga.ga_data + fd;
+	channel = ce->ce_channel;
+	if (channel == NULL)
+	    continue;
+
+	if ((ce->ce_events & EPOLLIN)
+			    && (revents & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+	    for (part = PART_SOCK; part < PART_IN; ++part)
+		if (channel->ch_part[part].ch_fd == fd)
+		{
+		    channel_read(channel, part, func);
+		    break;
+		}
+
+	/* Reading may have closed the fd. */
+	if (fd >= channel_epoll_ga.ga_len)
+	    continue;
+	ce = (ch_epoll_T *)channel_epoll_ga.ga_data + fd;
+	if (ce->ce_channel == channel && (ce->ce_events & EPOLLOUT)
+			    && (revents & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			    && (channel->CH_SOCK_FD == fd
+						     || channel->CH_IN_FD == fd))
+	    channel_write_input(channel);
+    }
+
+    for (i = 0; i < channel_keep_open_ga.ga_len; ++i)
+    {
+	channel_T *channel = ((channel_T **)channel_keep_open_ga.ga_data)[i];
+	ch_part_T part;
+
+	/* polling a keep-open channel */
+	for (part = PART_SOCK; part < PART_IN; ++part)
+	    if (channel->ch_part[part].ch_fd != INVALID_FD)
+		channel_read(channel, part, func);
+    }
+}
+# endif
+
 # if (defined(UNIX) && !defined(HAVE_SELECT)) || defined(PROTO)
+#  ifdef HAVE_EPOLL
+/* Index of the epoll fd in the poll() fds, -1 if not added. */
+static int channel_epoll_poll_idx = -1;
+#  endif
+
 /*
  * Add open channels to the poll struct.
  * Return the adjusted struct index.
@@ -4048,6 +4757,26 @@ channel_poll_setup(int nfd_in, void *fds_in, int *towait)
     struct	pollfd *fds = fds_in;
     ch_part_T	part;
 
+#  ifdef HAVE_EPOLL
+    if (channel_epoll_fd != -2)
+    {
+	/* Only the epoll fd needs to be added, see channel_epoll_update().
+	 * Keep-open channels are polled, see below. */
+	channel_epoll_poll_idx = -1;
+	if (channel_epoll_fd >= 0)
+	{
+	    channel_epoll_poll_idx = nfd;
+	    fds[nfd].fd = channel_epoll_fd;
+	    fds[nfd].events = POLLIN;
+	    nfd++;
+	}
+	if (channel_keep_open_ga.ga_len > 0
+				    && (*towait < 0 || *towait > KEEP_OPEN_TIME))
+	    *towait = KEEP_OPEN_TIME;
+	return nfd;
+    }
+#  endif
+
     for (channel = first_channel; channel != NULL; channel = channel->ch_next)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4069,6 +4798,8 @@ channel_poll_setup(int nfd_in, void *fds_in, int *towait)
 		    ch_part->ch_poll_idx = nfd;
 		    fds[nfd].fd = ch_part->ch_fd;
 		    fds[nfd].events = POLLIN;
+		    if (ch_part->ch_writeque.wq_next != NULL)
+			fds[nfd].events |= POLLOUT;
 		    nfd++;
 		}
 	    }
@@ -4095,12 +4826,34 @@ channel_poll_check(int ret_in, void *fds_in)
     int		idx;
     chanpart_T	*in_part;
 
+#  ifdef HAVE_EPOLL
+    if (channel_epoll_fd != -2)
+    {
+	idx = channel_epoll_poll_idx;
+	if (ret > 0 && idx != -1 && (fds[idx].revents & POLLIN))
+	{
+	    channel_epoll_check(TRUE, "channel_poll_check");
+	    --ret;
+	}
+	else
+	    channel_epoll_check(FALSE, "channel_poll_check");
+	return ret;
+    }
+#  endif
+
     for (channel = first_channel; channel != NULL; channel = channel->ch_next)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
 	{
 	    idx = channel->ch_part[part].ch_poll_idx;
 
+	    if (ret > 0 && idx != -1 && (fds[idx].revents & POLLOUT))
+	    {
+		/* Only the sock part has something queued to write. */
+		channel_write_input(channel);
+		if (!(fds[idx].revents & POLLIN))
+		    --ret;
+	    }
 	    if (ret > 0 && idx != -1 && (fds[idx].revents & POLLIN))
 	    {
 		channel_read(channel, part, "channel_poll_check");
@@ -4146,6 +4899,28 @@ channel_select_setup(
     fd_set	*wfds = wfds_in;
     ch_part_T	part;
 
+#  ifdef HAVE_EPOLL
+    if (channel_epoll_fd != -2)
+    {
+	/* Only the epoll fd needs to be added, see channel_epoll_update().
+	 * Keep-open channels are polled, see below. */
+	if (channel_epoll_fd >= 0)
+	{
+	    FD_SET(channel_epoll_fd, rfds);
+	    if (maxfd < channel_epoll_fd)
+		maxfd = channel_epoll_fd;
+	}
+	if (channel_keep_open_ga.ga_len > 0 && (*tvp == NULL
+		   || tv->tv_sec > 0 || tv->tv_usec > KEEP_OPEN_TIME * 1000))
+	{
+	    *tvp = tv;
+	    tv->tv_sec = 0;
+	    tv->tv_usec = KEEP_OPEN_TIME * 1000;
+	}
+	return maxfd;
+    }
+#  endif
+
     for (channel = first_channel; channel != NULL; channel = channel->ch_next)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4195,6 +4970,22 @@ channel_select_check(int ret_in, void *rfds_in, void *wfds_in)
     ch_part_T	part;
     chanpart_T	*in_part;
 
+#  ifdef HAVE_EPOLL
+    if (channel_epoll_fd != -2)
+    {
+	if (ret > 0 && channel_epoll_fd >= 0
+					   && FD_ISSET(channel_epoll_fd, rfds))
+	{
+	    FD_CLR(channel_epoll_fd, rfds);
+	    channel_epoll_check(TRUE, "channel_select_check");
+	    --ret;
+	}
+	else
+	    channel_epoll_check(FALSE, "channel_select_check");
+	return ret;
+    }
+#  endif
+
     for (channel = first_channel; channel != NULL; channel = channel->ch_next)
     {
 	for (part = PART_SOCK; part < PART_IN; ++part)
@@ -4215,6 +5006,13 @@ channel_select_check(int ret_in, void *rfds_in, void *wfds_in)
 	}
 
 	in_part = &channel->ch_part[PART_IN];
+	if (ret > 0 && channel->CH_SOCK_FD != INVALID_FD
+				       && FD_ISSET(channel->CH_SOCK_FD, wfds))
+	{
+	    FD_CLR(channel->CH_SOCK_FD, wfds);
+	    channel_write_input(channel);
+	    --ret;
+	}
 	if (ret > 0 && in_part->ch_fd != INVALID_FD
 					    && FD_ISSET(in_part->ch_fd, wfds))
 	{
@@ -4281,6 +5079,32 @@ channel_parse_messages(void)
 	    part = PART_SOCK;
 	    continue;
 	}
+	if (part == PART_SOCK && channel->ch_drain_pending)
+	{
+	    typval_T	argv[1];
+	    typval_T	rettv;
+	    int		dummy;
+
+	    /* The write queue drained below "write_low". */
+	    channel->ch_drain_pending = FALSE;
+	    ++channel->ch_refcount;
+	    ch_log(channel, "Invoking drain callback %s",
+						(char *)channel->ch_drain_cb);
+	    argv[0].v_type = VAR_CHANNEL;
+	    argv[0].vval.v_channel = channel;
+	    call_func(channel->ch_drain_cb, (int)STRLEN(channel->ch_drain_cb),
+			   &rettv, 1, argv, NULL, 0L, 0L, &dummy, TRUE,
+			   channel->ch_drain_partial, NULL);
+	    clear_tv(&rettv);
+	    channel_need_redraw = TRUE;
+	    ret = TRUE;
+	    if (channel_unref(channel))
+	    {
+		/* channel was freed, start over */
+		channel = first_channel;
+		continue;
+	    }
+	}
 	if (channel->ch_part[part].ch_fd != INVALID_FD
 				      || channel_has_readahead(channel, part))
 	{
@@ -4427,6 +5251,8 @@ handle_mode(typval_T *item, jobopt_T *opt, ch_mode_T *modep, int jo)
 	*modep = MODE_JS;
     else if (STRCMP(val, "json") == 0)
 	*modep = MODE_JSON;
+    else if (STRCMP(val, "msgpack") == 0)
+	*modep = MODE_MSGPACK;
     else
     {
 	EMSG2(_(e_invarg2), val);
@@ -4494,6 +5320,10 @@ free_job_options(jobopt_T *opt)
 	partial_unref(opt->jo_exit_partial);
     else if (opt->jo_exit_cb != NULL)
 	func_unref(opt->jo_exit_cb);
+    if (opt->jo_drain_partial != NULL)
+	partial_unref(opt->jo_drain_partial);
+    else if (opt->jo_drain_cb != NULL)
+	func_unref(opt->jo_drain_cb);
     if (opt->jo_env != NULL)
 	dict_unref(opt->jo_env);
 }
@@ -4723,6 +5553,18 @@ get_job_options(typval_T *tv, jobopt_T *opt, int supported, int supported2)
 		    return FAIL;
 		}
 	    }
+	    else if (STRCMP(hi->hi_key, "drain_cb") == 0)
+	    {
+		if (!(supported2 & JO2_DRAIN_CB))
+		    break;
+		opt->jo_set2 |= JO2_DRAIN_CB;
+		opt->jo_drain_cb = get_callback(item, &opt->jo_drain_partial);
+		if (opt->jo_drain_cb == NULL)
+		{
+		    EMSG2(_(e_invargval), "drain_cb");
+		    return FAIL;
+		}
+	    }
 	    else if (STRCMP(hi->hi_key, "drop") == 0)
 	    {
 		int never = FALSE;
@@ -4995,6 +5837,18 @@ get_job_options(typval_T *tv, jobopt_T *opt, int supported, int supported2)
 		    return FAIL;
 		}
 	    }
+	    else if (STRCMP(hi->hi_key, "batch") == 0)
+	    {
+		if (!(supported2 & JO2_BATCH))
+		    break;
+		opt->jo_set2 |= JO2_BATCH;
+		opt->jo_batch = get_tv_number(item);
+		if (opt->jo_batch < 0)
+		{
+		    EMSG2(_(e_invargval), "batch");
+		    return FAIL;
+		}
+	    }
 	    else if (STRCMP(hi->hi_key, "block_write") == 0)
 	    {
 		if (!(supported & JO_BLOCK_WRITE))
@@ -5002,6 +5856,31 @@ get_job_options(typval_T *tv, jobopt_T *opt, int supported, int supported2)
 		opt->jo_set |= JO_BLOCK_WRITE;
 		opt->jo_block_write = get_tv_number(item);
 	    }
+	    else if (STRCMP(hi->hi_key, "write_high") == 0
+		    || STRCMP(hi->hi_key, "write_low") == 0)
+	    {
+		int	high = hi->hi_key[6] == 'h';
+		long	n;
+
+		if (!(supported2 & (high ? JO2_WRITE_HIGH : JO2_WRITE_LOW)))
+		    break;
+		n = (long)get_tv_number(item);
+		if (n < 0)
+		{
+		    EMSG2(_(e_invargval), hi->hi_key);
+		    return FAIL;
+		}
+		if (high)
+		{
+		    opt->jo_set2 |= JO2_WRITE_HIGH;
+		    opt->jo_write_high = n;
+		}
+		else
+		{
+		    opt->jo_set2 |= JO2_WRITE_LOW;
+		    opt->jo_write_low = n;
+		}
+	    }
 	    else
 		break;
 	    --todo;
@@ -5491,6 +6370,16 @@ has_pending_job(void)
     return FALSE;
 }
 
+/*
+ * Return TRUE when there is any channel or job.  These may become garbage
+ * without a reference being removed, e.g. when a job ends.
+ */
+    int
+has_channel_or_job(void)
+{
+    return first_channel != NULL || first_job != NULL;
+}
+
 #define MAX_CHECK_ENDED 8
 
 /*
@@ -5564,7 +6453,7 @@ job_start(typval_T *argvars, char **argv_arg, jobopt_T *opt_arg)
 	if (get_job_options(&argvars[1], &opt,
 		    JO_MODE_ALL + JO_CB_ALL + JO_TIMEOUT_ALL + JO_STOPONEXIT
 			 + JO_EXIT_CB + JO_OUT_IO + JO_BLOCK_WRITE,
-		     JO2_ENV + JO2_CWD) == FAIL)
+		     JO2_ENV + JO2_CWD + JO2_BATCH + JO2_WRITE_ALL) == FAIL)
 	    goto theend;
     }
 
@@ -304,6 +304,19 @@ buf_init_chartab(
 	}
     }
     chartab_initialized = TRUE;
+
+#ifdef FEAT_SEARCH_EXTRA
+    /* Cached 'hlsearch' matches may depend on the character classes. */
+    if (global)
+    {
+	buf_T	*bp;
+
+	FOR_ALL_BUFFERS(bp)
+	    hls_cache_free(bp);
+    }
+    else
+	hls_cache_free(buf);
+#endif
     return OK;
 }
 
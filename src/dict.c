@@ -146,19 +146,24 @@ dict_free(dict_T *d)
     void
 dict_unref(dict_T *d)
 {
-    if (d != NULL && --d->dv_refcount <= 0)
-	dict_free(d);
+    if (d != NULL)
+    {
+	if (--d->dv_refcount <= 0)
+	    dict_free(d);
+	else
+	    may_have_garbage = TRUE;
+    }
 }
 
 /*
  * Go through the list of dicts and free items without the copyID.
- * Returns TRUE if something was freed.
+ * Returns the number of dicts freed.
  */
     int
 dict_free_nonref(int copyID)
 {
     dict_T	*dd;
-    int		did_free = FALSE;
+    int		did_free = 0;
 
     for (dd = first_dict; dd != NULL; dd = dd->dv_used_next)
 	if ((dd->dv_copyID & COPYID_MASK) != (copyID & COPYID_MASK))
@@ -167,7 +172,7 @@ dict_free_nonref(int copyID)
 	     * recurse into Lists and Dictionaries, they will be in the list
 	     * of dicts or list of lists. */
 	    dict_free_contents(dd);
-	    did_free = TRUE;
+	    ++did_free;
 	}
     return did_free;
 }
@@ -362,6 +367,31 @@ dict_add_nr_str(
     return OK;
 }
 
+#if defined(FEAT_FLOAT) || defined(PROTO)
+/*
+ * Add a float entry to dictionary "d".
+ * Returns FAIL when out of memory and when key already exists.
+ */
+    int
+dict_add_float(dict_T *d, char *key, float_T f)
+{
+    dictitem_T	*item;
+
+    item = dictitem_alloc((char_u *)key);
+    if (item == NULL)
+	return FAIL;
+    item->di_tv.v_lock = 0;
+    item->di_tv.v_type = VAR_FLOAT;
+    item->di_tv.vval.v_float = f;
+    if (dict_add(d, item) == FAIL)
+    {
+	dictitem_free(item);
+	return FAIL;
+    }
+    return OK;
+}
+#endif
+
 /*
  * Add a list entry to dictionary "d".
  * Returns FAIL when out of memory and when key already exists.
@@ -220,6 +220,7 @@ static char_u *list_arg_vars(exarg_T *eap, char_u *arg, int *first);
 static char_u *ex_let_one(char_u *arg, typval_T *tv, int copy, char_u *endchars, char_u *op);
 static void set_var_lval(lval_T *lp, char_u *endp, typval_T *rettv, int copy, char_u *op);
 static int tv_op(typval_T *tv1, typval_T *tv2, char_u  *op);
+static int tv_str_append(typval_T *tv, char_u *s);
 static void ex_unletlock(exarg_T *eap, char_u *argstart, int deep);
 static int do_unlet_var(lval_T *lp, char_u *name_end, int forceit);
 static int do_lock_var(lval_T *lp, char_u *name_end, int deep, int lock);
@@ -245,6 +246,7 @@ static void delete_var(hashtab_T *ht, hashitem_T *hi);
 static void list_one_var(dictitem_T *v, char_u *prefix, int *first);
 static void list_one_var_a(char_u *prefix, char_u *name, int type, char_u *string, int *first);
 static char_u *find_option_end(char_u **arg, int *opt_flags);
+static char_u *regmatch_string_sub(regmatch_T *regmatch, char_u *str, char_u *sub, typval_T *expr, int do_all);
 
 /* for VIM_VERSION_ defines */
 #include "version.h"
@@ -2258,7 +2260,18 @@ set_var_lval(
 
 	    /* handle +=, -= and .= */
 	    di = NULL;
-	    if (get_var_tv(lp->ll_name, (int)STRLEN(lp->ll_name),
+	    if (*op == '.' && get_var_tv(lp->ll_name, (int)STRLEN(lp->ll_name),
+					     NULL, &di, TRUE, FALSE) == OK
+		    && di->di_tv.v_type == VAR_STRING)
+	    {
+		/* String .= expr: append to the value of the variable, avoids
+		 * copying it twice. */
+		if (!var_check_ro(di->di_flags, lp->ll_name, FALSE)
+			&& !tv_check_lock(di->di_tv.v_lock, lp->ll_name,
+								       FALSE))
+		    (void)tv_op(&di->di_tv, rettv, op);
+	    }
+	    else if (get_var_tv(lp->ll_name, (int)STRLEN(lp->ll_name),
 					     &tv, &di, TRUE, FALSE) == OK)
 	    {
 		if ((di == NULL
@@ -2377,6 +2390,31 @@ set_var_lval(
     }
 }
 
+/*
+ * Append "s" to the String in "tv".  The allocated String is resized, when
+ * realloc() can extend the memory block in place the text isn't copied, thus
+ * repeatedly appending to a String isn't quadratic.
+ * Returns FAIL when "tv" is not an allocated String or out of memory, "tv"
+ * is unchanged then.
+ */
+    static int
+tv_str_append(typval_T *tv, char_u *s)
+{
+    size_t	len1, len2;
+    char_u	*p;
+
+    if (tv->v_type != VAR_STRING || tv->vval.v_string == NULL)
+	return FAIL;
+    len1 = STRLEN(tv->vval.v_string);
+    len2 = STRLEN(s);
+    p = vim_realloc(tv->vval.v_string, len1 + len2 + 1);
+    if (p == NULL)
+	return FAIL;
+    mch_memmove(p + len1, s, len2 + 1);
+    tv->vval.v_string = p;
+    return OK;
+}
+
 /*
  * Handle "tv1 += tv2", "tv1 -= tv2" and "tv1 .= tv2"
  * Returns OK or FAIL.
@@ -2450,6 +2488,9 @@ tv_op(typval_T *tv1, typval_T *tv2, char_u *op)
 			break;
 
 		    /* str .= str */
+		    if (tv_str_append(tv1, get_tv_string_buf(tv2, numbuf))
+									 == OK)
+			return OK;
 		    s = get_tv_string(tv1);
 		    s = concat_str(s, get_tv_string_buf(tv2, numbuf));
 		    clear_tv(tv1);
@@ -2896,6 +2937,8 @@ do_unlet(char_u *name, int forceit)
 	    }
 	}
 	hi = hash_find(ht, varname);
+	if (HASHITEM_EMPTY(hi) && add_lazy_args_ht(ht, varname))
+	    hi = hash_find(ht, varname);
 	if (HASHITEM_EMPTY(hi))
 	    hi = find_hi_in_scoped_ht(name, &ht);
 	if (hi != NULL && !HASHITEM_EMPTY(hi))
@@ -3693,10 +3736,14 @@ eval5(char_u **arg, typval_T *rettv, int evaluate)
 		    clear_tv(&var2);
 		    return FAIL;
 		}
-		p = concat_str(s1, s2);
-		clear_tv(rettv);
-		rettv->v_type = VAR_STRING;
-		rettv->vval.v_string = p;
+		/* The result replaces "rettv", append to it when possible. */
+		if (tv_str_append(rettv, s2) == FAIL)
+		{
+		    p = concat_str(s1, s2);
+		    clear_tv(rettv);
+		    rettv->v_type = VAR_STRING;
+		    rettv->vval.v_string = p;
+		}
 	    }
 	    else if (op == '+' && rettv->v_type == VAR_LIST
 						   && var2.v_type == VAR_LIST)
@@ -4890,8 +4937,13 @@ partial_free(partial_T *pt)
     void
 partial_unref(partial_T *pt)
 {
-    if (pt != NULL && --pt->pt_refcount <= 0)
-	partial_free(pt);
+    if (pt != NULL)
+    {
+	if (--pt->pt_refcount <= 0)
+	    partial_free(pt);
+	else
+	    may_have_garbage = TRUE;
+    }
 }
 
 static int tv_equal_recurse_limit;
@@ -5074,6 +5126,18 @@ get_copyID(void)
  *	http://python.ca/nas/python/gc/
  */
 
+/* Statistics for garbagecollect_info(). */
+static long	gc_count = 0;		/* number of collections done */
+static long	gc_skipped = 0;		/* number of collections skipped */
+static long	gc_marked = 0;		/* lists and dicts marked last time */
+static long	gc_freed = 0;		/* lists and dicts freed last time */
+static long	gc_freed_total = 0;	/* lists and dicts freed in total */
+#if defined(FEAT_RELTIME) && defined(FEAT_FLOAT)
+static float_T	gc_time = 0;		/* duration of the last collection */
+static float_T	gc_time_max = 0;	/* longest duration of a collection */
+static float_T	gc_time_total = 0;	/* total duration of collections */
+#endif
+
 /*
  * Do garbage collection for lists and dicts.
  * When "testing" is TRUE this is called from test_garbagecollect_now().
@@ -5089,6 +5153,11 @@ garbage_collect(int testing)
     int		i;
     int		did_free = FALSE;
     tabpage_T	*tp;
+#if defined(FEAT_RELTIME) && defined(FEAT_FLOAT)
+    proftime_T	start;
+
+    profile_start(&start);
+#endif
 
     if (!testing)
     {
@@ -5098,6 +5167,12 @@ garbage_collect(int testing)
 	garbage_collect_at_exit = FALSE;
     }
 
+    /* Anything unreferenced from now on is found by the next collection. */
+    may_have_garbage = FALSE;
+    ++gc_count;
+    gc_marked = 0;
+    gc_freed = 0;
+
     /* We advance by two because we add one for items referenced through
      * previous_funccal. */
     copyID = get_copyID();
@@ -5193,14 +5268,64 @@ garbage_collect(int testing)
 	 */
 	free_unref_funccal(copyID, testing);
     }
-    else if (p_verbose > 0)
+    else
     {
-	verb_msg((char_u *)_("Not enough memory to set references, garbage collection aborted!"));
+	/* Try again next time. */
+	may_have_garbage = TRUE;
+	if (p_verbose > 0)
+	    verb_msg((char_u *)_("Not enough memory to set references, garbage collection aborted!"));
     }
 
+#if defined(FEAT_RELTIME) && defined(FEAT_FLOAT)
+    profile_end(&start);
+    gc_time = profile_float(&start);
+    if (gc_time > gc_time_max)
+	gc_time_max = gc_time;
+    gc_time_total += gc_time;
+#endif
+
     return did_free;
 }
 
+/*
+ * Called before waiting for a character: do garbage collection, unless
+ * nothing can have become garbage since the previous collection.
+ */
+    void
+garbage_collect_when_idle(void)
+{
+    if (!may_have_garbage
+#ifdef FEAT_JOB_CHANNEL
+	    && !has_channel_or_job()
+#endif
+	    )
+    {
+	/* Only check this once, like garbage_collect() does. */
+	may_garbage_collect = FALSE;
+	++gc_skipped;
+	return;
+    }
+    (void)garbage_collect(FALSE);
+}
+
+/*
+ * Fill "dict" with the garbage collection statistics.
+ */
+    void
+get_garbage_collect_info(dict_T *dict)
+{
+    dict_add_nr_str(dict, "count", gc_count, NULL);
+    dict_add_nr_str(dict, "skipped", gc_skipped, NULL);
+    dict_add_nr_str(dict, "marked", gc_marked, NULL);
+    dict_add_nr_str(dict, "freed", gc_freed, NULL);
+    dict_add_nr_str(dict, "total_freed", gc_freed_total, NULL);
+#if defined(FEAT_RELTIME) && defined(FEAT_FLOAT)
+    dict_add_float(dict, "time", gc_time);
+    dict_add_float(dict, "max_time", gc_time_max);
+    dict_add_float(dict, "total_time", gc_time_total);
+#endif
+}
+
 /*
  * Free lists, dictionaries, channels and jobs that are no longer referenced.
  */
@@ -5208,6 +5333,7 @@ garbage_collect(int testing)
 free_unref_items(int copyID)
 {
     int		did_free = FALSE;
+    int		count;
 
     /* Let all "free" functions know that we are here.  This means no
      * dictionaries, lists, channels or jobs are to be freed, because we will
@@ -5220,10 +5346,14 @@ free_unref_items(int copyID)
      */
 
     /* Go through the list of dicts and free items without the copyID. */
-    did_free |= dict_free_nonref(copyID);
+    count = dict_free_nonref(copyID);
 
     /* Go through the list of lists and free items without the copyID. */
-    did_free |= list_free_nonref(copyID);
+    count += list_free_nonref(copyID);
+
+    gc_freed += count;
+    gc_freed_total += count;
+    did_free = count > 0;
 
 #ifdef FEAT_JOB_CHANNEL
     /* Go through the list of jobs and free items without the copyID. This
@@ -5365,6 +5495,7 @@ set_ref_in_item(
 	{
 	    /* Didn't see this dict yet. */
 	    dd->dv_copyID = copyID;
+	    ++gc_marked;
 	    if (ht_stack == NULL)
 	    {
 		abort = set_ref_in_ht(&dd->dv_hashtab, copyID, list_stack);
@@ -5391,6 +5522,7 @@ set_ref_in_item(
 	{
 	    /* Didn't see this list yet. */
 	    ll->lv_copyID = copyID;
+	    ++gc_marked;
 	    if (list_stack == NULL)
 	    {
 		abort = set_ref_in_list(ll, copyID, ht_stack);
@@ -5478,6 +5610,8 @@ set_ref_in_item(
 		for (jq = ch->ch_part[part].ch_json_head.jq_next; jq != NULL;
 							     jq = jq->jq_next)
 		    set_ref_in_item(jq->jq_value, copyID, ht_stack, list_stack);
+		set_ref_in_json_partial(&ch->ch_part[part].ch_json_partial,
+						copyID, ht_stack, list_stack);
 		for (cq = ch->ch_part[part].ch_cb_head.cq_next; cq != NULL;
 							     cq = cq->cq_next)
 		    if (cq->cq_partial != NULL)
@@ -5505,6 +5639,12 @@ set_ref_in_item(
 		dtv.vval.v_partial = ch->ch_close_partial;
 		set_ref_in_item(&dtv, copyID, ht_stack, list_stack);
 	    }
+	    if (ch->ch_drain_partial != NULL)
+	    {
+		dtv.v_type = VAR_PARTIAL;
+		dtv.vval.v_partial = ch->ch_drain_partial;
+		set_ref_in_item(&dtv, copyID, ht_stack, list_stack);
+	    }
 	}
     }
 #endif
@@ -7250,6 +7390,8 @@ find_var_in_ht(
 		return NULL;
 	    hi = hash_find(ht, varname);
 	}
+	else if (add_lazy_args_ht(ht, varname))
+	    hi = hash_find(ht, varname);
 	if (HASHITEM_EMPTY(hi))
 	    return NULL;
     }
@@ -10083,6 +10225,87 @@ repeat:
     return valid;
 }
 
+/*
+ * Perform a substitution on "str" with the compiled pattern in "regmatch" and
+ * substitute "sub".  When "sub" is NULL "expr" is used.
+ * When "do_all" is TRUE do a global substitute.
+ * Returns an allocated string, NULL when out of memory.
+ */
+    static char_u *
+regmatch_string_sub(
+    regmatch_T	*regmatch,
+    char_u	*str,
+    char_u	*sub,
+    typval_T	*expr,
+    int		do_all)
+{
+    int		sublen;
+    int		i;
+    char_u	*tail;
+    char_u	*end;
+    garray_T	ga;
+    char_u	*ret;
+    char_u	*zero_width = NULL;
+
+    ga_init2(&ga, 1, 200);
+
+    tail = str;
+    end = str + STRLEN(str);
+    while (vim_regexec_nl(regmatch, str, (colnr_T)(tail - str)))
+    {
+	/* Skip empty match except for first match. */
+	if (regmatch->startp[0] == regmatch->endp[0])
+	{
+	    if (zero_width == regmatch->startp[0])
+	    {
+		/* avoid getting stuck on a match with an empty string */
+		i = MB_PTR2LEN(tail);
+		mch_memmove((char_u *)ga.ga_data + ga.ga_len, tail,
+								   (size_t)i);
+		ga.ga_len += i;
+		tail += i;
+		continue;
+	    }
+	    zero_width = regmatch->startp[0];
+	}
+
+	/*
+	 * Get some space for a temporary buffer to do the substitution
+	 * into.  It will contain:
+	 * - The text up to where the match is.
+	 * - The substituted text.
+	 * - The text after the match.
+	 */
+	sublen = vim_regsub(regmatch, sub, expr, tail, FALSE, TRUE, FALSE);
+	if (ga_grow(&ga, (int)((end - tail) + sublen -
+			    (regmatch->endp[0] - regmatch->startp[0]))) == FAIL)
+	{
+	    ga_clear(&ga);
+	    break;
+	}
+
+	/* copy the text up to where the match is */
+	i = (int)(regmatch->startp[0] - tail);
+	mch_memmove((char_u *)ga.ga_data + ga.ga_len, tail, (size_t)i);
+	/* add the substituted text */
+	(void)vim_regsub(regmatch, sub, expr, (char_u *)ga.ga_data
+					  + ga.ga_len + i, TRUE, TRUE, FALSE);
+	ga.ga_len += i + sublen - 1;
+	tail = regmatch->endp[0];
+	if (*tail == NUL)
+	    break;
+	if (!do_all)
+	    break;
+    }
+
+    if (ga.ga_data != NULL)
+	STRCPY((char *)ga.ga_data + ga.ga_len, tail);
+
+    ret = vim_strsave(ga.ga_data == NULL ? str : (char_u *)ga.ga_data);
+    ga_clear(&ga);
+    return ret;
+}
+
 /*
  * Perform a substitution on "str" with pattern "pat" and substitute "sub".
  * When "sub" is NULL "expr" is used, must be a VAR_FUNC or VAR_PARTIAL.
@@ -10097,86 +10320,88 @@ do_string_sub(
     typval_T	*expr,
     char_u	*flags)
 {
-    int		sublen;
     regmatch_T	regmatch;
-    int		i;
-    int		do_all;
-    char_u	*tail;
-    char_u	*end;
-    garray_T	ga;
     char_u	*ret;
     char_u	*save_cpo;
-    char_u	*zero_width = NULL;
 
     /* Make 'cpoptions' empty, so that the 'l' flag doesn't work here */
     save_cpo = p_cpo;
     p_cpo = empty_option;
 
-    ga_init2(&ga, 1, 200);
+    regmatch.rm_ic = p_ic;
+    regmatch.regprog = vim_regcomp(pat, RE_MAGIC + RE_STRING);
+    if (regmatch.regprog != NULL)
+    {
+	ret = regmatch_string_sub(&regmatch, str, sub, expr, flags[0] == 'g');
+	vim_regfree(regmatch.regprog);
+    }
+    else
+	ret = vim_strsave(str);
+
+    if (p_cpo == empty_option)
+	p_cpo = save_cpo;
+    else
+	/* Darn, evaluating {sub} expression or {expr} changed the value. */
+	free_string_option(save_cpo);
+
+    return ret;
+}
+
+/*
+ * Like do_string_sub(), but for each item in list "l".  The pattern is
+ * compiled only once.  The results are appended to list "result".
+ * Returns FAIL when an item is not a String or Number.
+ */
+    int
+do_list_sub(
+    list_T	*l,
+    char_u	*pat,
+    char_u	*sub,
+    typval_T	*expr,
+    char_u	*flags,
+    list_T	*result)
+{
+    regmatch_T	regmatch;
+    listwatch_T	lw;
+    listitem_T	*li;
+    listitem_T	*ni;
+    char_u	*str;
+    char_u	buf[NUMBUFLEN];
+    char_u	*save_cpo;
+    int		ret = OK;
 
-    do_all = (flags[0] == 'g');
+    /* Make 'cpoptions' empty, so that the 'l' flag doesn't work here */
+    save_cpo = p_cpo;
+    p_cpo = empty_option;
 
     regmatch.rm_ic = p_ic;
     regmatch.regprog = vim_regcomp(pat, RE_MAGIC + RE_STRING);
     if (regmatch.regprog != NULL)
     {
-	tail = str;
-	end = str + STRLEN(str);
-	while (vim_regexec_nl(&regmatch, str, (colnr_T)(tail - str)))
+	/* "expr" may change the list, use a watcher to get the next item. */
+	list_add_watch(l, &lw);
+	for (li = l->lv_first; li != NULL; li = lw.lw_item)
 	{
-	    /* Skip empty match except for first match. */
-	    if (regmatch.startp[0] == regmatch.endp[0])
+	    lw.lw_item = li->li_next;
+	    str = get_tv_string_buf_chk(&li->li_tv, buf);
+	    if (str == NULL)
 	    {
-		if (zero_width == regmatch.startp[0])
-		{
-		    /* avoid getting stuck on a match with an empty string */
-		    i = MB_PTR2LEN(tail);
-		    mch_memmove((char_u *)ga.ga_data + ga.ga_len, tail,
-								   (size_t)i);
-		    ga.ga_len += i;
-		    tail += i;
-		    continue;
-		}
-		zero_width = regmatch.startp[0];
-	    }
-
-	    /*
-	     * Get some space for a temporary buffer to do the substitution
-	     * into.  It will contain:
-	     * - The text up to where the match is.
-	     * - The substituted text.
-	     * - The text after the match.
-	     */
-	    sublen = vim_regsub(&regmatch, sub, expr, tail, FALSE, TRUE, FALSE);
-	    if (ga_grow(&ga, (int)((end - tail) + sublen -
-			    (regmatch.endp[0] - regmatch.startp[0]))) == FAIL)
-	    {
-		ga_clear(&ga);
+		ret = FAIL;
 		break;
 	    }
-
-	    /* copy the text up to where the match is */
-	    i = (int)(regmatch.startp[0] - tail);
-	    mch_memmove((char_u *)ga.ga_data + ga.ga_len, tail, (size_t)i);
-	    /* add the substituted text */
-	    (void)vim_regsub(&regmatch, sub, expr, (char_u *)ga.ga_data
-					  + ga.ga_len + i, TRUE, TRUE, FALSE);
-	    ga.ga_len += i + sublen - 1;
-	    tail = regmatch.endp[0];
-	    if (*tail == NUL)
-		break;
-	    if (!do_all)
+	    ni = listitem_alloc();
+	    if (ni == NULL)
 		break;
+	    ni->li_tv.v_type = VAR_STRING;
+	    ni->li_tv.v_lock = 0;
+	    ni->li_tv.vval.v_string = regmatch_string_sub(&regmatch, str, sub,
+						       expr, flags[0] == 'g');
+	    list_append(result, ni);
 	}
-
-	if (ga.ga_data != NULL)
-	    STRCPY((char *)ga.ga_data + ga.ga_len, tail);
-
+	list_rem_watch(l, &lw);
 	vim_regfree(regmatch.regprog);
     }
 
-    ret = vim_strsave(ga.ga_data == NULL ? str : (char_u *)ga.ga_data);
-    ga_clear(&ga);
     if (p_cpo == empty_option)
 	p_cpo = save_cpo;
     else
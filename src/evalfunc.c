@@ -86,6 +86,7 @@ static void f_ceil(typval_T *argvars, typval_T *rettv);
 #endif
 #ifdef FEAT_JOB_CHANNEL
 static void f_ch_canread(typval_T *argvars, typval_T *rettv);
+static void f_ch_canwrite(typval_T *argvars, typval_T *rettv);
 static void f_ch_close(typval_T *argvars, typval_T *rettv);
 static void f_ch_close_in(typval_T *argvars, typval_T *rettv);
 static void f_ch_evalexpr(typval_T *argvars, typval_T *rettv);
@@ -162,6 +163,7 @@ static void f_foreground(typval_T *argvars, typval_T *rettv);
 static void f_funcref(typval_T *argvars, typval_T *rettv);
 static void f_function(typval_T *argvars, typval_T *rettv);
 static void f_garbagecollect(typval_T *argvars, typval_T *rettv);
+static void f_garbagecollect_info(typval_T *argvars, typval_T *rettv);
 static void f_get(typval_T *argvars, typval_T *rettv);
 static void f_getbufinfo(typval_T *argvars, typval_T *rettv);
 static void f_getbufline(typval_T *argvars, typval_T *rettv);
@@ -268,6 +270,7 @@ static void f_match(typval_T *argvars, typval_T *rettv);
 static void f_matchadd(typval_T *argvars, typval_T *rettv);
 static void f_matchaddpos(typval_T *argvars, typval_T *rettv);
 static void f_matcharg(typval_T *argvars, typval_T *rettv);
+static void f_matchbufline(typval_T *argvars, typval_T *rettv);
 static void f_matchdelete(typval_T *argvars, typval_T *rettv);
 static void f_matchend(typval_T *argvars, typval_T *rettv);
 static void f_matchlist(typval_T *argvars, typval_T *rettv);
@@ -330,6 +333,7 @@ static void f_screenchar(typval_T *argvars, typval_T *rettv);
 static void f_screencol(typval_T *argvars, typval_T *rettv);
 static void f_screenrow(typval_T *argvars, typval_T *rettv);
 static void f_search(typval_T *argvars, typval_T *rettv);
+static void f_searchcount(typval_T *argvars, typval_T *rettv);
 static void f_searchdecl(typval_T *argvars, typval_T *rettv);
 static void f_searchpair(typval_T *argvars, typval_T *rettv);
 static void f_searchpairpos(typval_T *argvars, typval_T *rettv);
@@ -531,6 +535,7 @@ static struct fst
 #endif
 #ifdef FEAT_JOB_CHANNEL
     {"ch_canread",	1, 1, f_ch_canread},
+    {"ch_canwrite",	1, 1, f_ch_canwrite},
     {"ch_close",	1, 1, f_ch_close},
     {"ch_close_in",	1, 1, f_ch_close_in},
     {"ch_evalexpr",	2, 3, f_ch_evalexpr},
@@ -608,6 +613,7 @@ static struct fst
     {"funcref",		1, 3, f_funcref},
     {"function",	1, 3, f_function},
     {"garbagecollect",	0, 1, f_garbagecollect},
+    {"garbagecollect_info", 0, 0, f_garbagecollect_info},
     {"get",		2, 3, f_get},
     {"getbufinfo",	0, 1, f_getbufinfo},
     {"getbufline",	2, 3, f_getbufline},
@@ -716,6 +722,7 @@ static struct fst
     {"matchadd",	2, 5, f_matchadd},
     {"matchaddpos",	2, 5, f_matchaddpos},
     {"matcharg",	1, 1, f_matcharg},
+    {"matchbufline",	4, 5, f_matchbufline},
     {"matchdelete",	1, 1, f_matchdelete},
     {"matchend",	2, 4, f_matchend},
     {"matchlist",	2, 4, f_matchlist},
@@ -778,6 +785,7 @@ static struct fst
     {"screencol",	0, 0, f_screencol},
     {"screenrow",	0, 0, f_screenrow},
     {"search",		1, 4, f_search},
+    {"searchcount",	0, 1, f_searchcount},
     {"searchdecl",	1, 3, f_searchdecl},
     {"searchpair",	3, 7, f_searchpair},
     {"searchpairpos",	3, 7, f_searchpairpos},
@@ -1904,6 +1912,17 @@ f_ch_canread(typval_T *argvars, typval_T *rettv)
 			    || channel_has_readahead(channel, PART_ERR);
 }
 
+/*
+ * "ch_canwrite()" function
+ */
+    static void
+f_ch_canwrite(typval_T *argvars, typval_T *rettv)
+{
+    channel_T *channel = get_channel_arg(&argvars[0], FALSE, FALSE, 0);
+
+    rettv->vval.v_number = channel_writable(channel);
+}
+
 /*
  * "ch_close()" function
  */
@@ -2102,7 +2121,8 @@ f_ch_setoptions(typval_T *argvars, typval_T *rettv UNUSED)
 	return;
     clear_job_options(&opt);
     if (get_job_options(&argvars[1], &opt,
-			    JO_CB_ALL + JO_TIMEOUT_ALL + JO_MODE_ALL, 0) == OK)
+				JO_CB_ALL + JO_TIMEOUT_ALL + JO_MODE_ALL,
+					     JO2_BATCH + JO2_WRITE_ALL) == OK)
 	channel_set_options(channel, &opt);
     free_job_options(&opt);
 }
@@ -3962,6 +3982,16 @@ f_garbagecollect(typval_T *argvars, typval_T *rettv UNUSED)
 	garbage_collect_at_exit = TRUE;
 }
 
+/*
+ * "garbagecollect_info()" function
+ */
+    static void
+f_garbagecollect_info(typval_T *argvars UNUSED, typval_T *rettv)
+{
+    if (rettv_dict_alloc(rettv) == OK)
+	get_garbage_collect_info(rettv->vval.v_dict);
+}
+
 /*
  * "get()" function
  */
@@ -7895,6 +7925,125 @@ f_matcharg(typval_T *argvars UNUSED, typval_T *rettv)
     }
 }
 
+/*
+ * "matchbufline()" function
+ */
+    static void
+f_matchbufline(typval_T *argvars, typval_T *rettv)
+{
+    buf_T	*buf;
+    linenr_T	lnum;
+    linenr_T	end;
+    char_u	*pat;
+    char_u	patbuf[NUMBUFLEN];
+    int		submatches = FALSE;
+    regmatch_T	regmatch;
+    char_u	*save_cpo;
+    char_u	*line;
+    colnr_T	col;
+    char_u	*s;
+    dict_T	*d;
+    list_T	*l;
+    int		i;
+
+    if (rettv_list_alloc(rettv) == FAIL)
+	return;
+
+    (void)get_tv_number(&argvars[0]);	    /* issue errmsg if type error */
+    ++emsg_off;
+    buf = get_buf_tv(&argvars[0], FALSE);
+    --emsg_off;
+    if (buf == NULL || buf->b_ml.ml_mfp == NULL)
+    {
+	EMSG2(_(e_invarg2), get_tv_string(&argvars[0]));
+	return;
+    }
+
+    lnum = get_tv_lnum_buf(&argvars[2], buf);
+    end = get_tv_lnum_buf(&argvars[3], buf);
+    if (lnum < 1 || lnum > buf->b_ml.ml_line_count
+	    || end < lnum || end > buf->b_ml.ml_line_count)
+    {
+	EMSG(_(e_invrange));
+	return;
+    }
+
+    if (argvars[4].v_type != VAR_UNKNOWN)
+    {
+	if (argvars[4].v_type != VAR_DICT || argvars[4].vval.v_dict == NULL)
+	{
+	    EMSG(_(e_dictreq));
+	    return;
+	}
+	submatches = get_dict_number(argvars[4].vval.v_dict,
+					       (char_u *)"submatches") != 0;
+    }
+
+    pat = get_tv_string_buf_chk(&argvars[1], patbuf);
+    if (pat == NULL)
+	return;
+
+    /* Make 'cpoptions' empty, the 'l' flag should not be used here. */
+    save_cpo = p_cpo;
+    p_cpo = (char_u *)"";
+
+    regmatch.rm_ic = p_ic;
+    regmatch.regprog = vim_regcomp(pat, RE_MAGIC + RE_STRING);
+    if (regmatch.regprog != NULL)
+    {
+	/* Match directly in the buffer text, only the matches are copied. */
+	for ( ; lnum <= end && !got_int; ++lnum)
+	{
+	    line = ml_get_buf(buf, lnum, FALSE);
+	    col = 0;
+	    while (vim_regexec_nl(&regmatch, line, col))
+	    {
+		d = dict_alloc();
+		if (d == NULL)
+		    break;
+		if (list_append_dict(rettv->vval.v_list, d) == FAIL)
+		{
+		    dict_unref(d);
+		    break;
+		}
+		dict_add_nr_str(d, "lnum", (varnumber_T)lnum, NULL);
+		dict_add_nr_str(d, "byteidx",
+			       (varnumber_T)(regmatch.startp[0] - line), NULL);
+		s = vim_strnsave(regmatch.startp[0],
+			       (int)(regmatch.endp[0] - regmatch.startp[0]));
+		if (s != NULL)
+		{
+		    dict_add_nr_str(d, "text", 0L, s);
+		    vim_free(s);
+		}
+		if (submatches && (l = list_alloc()) != NULL)
+		{
+		    if (dict_add_list(d, "submatches", l) == FAIL)
+			list_free(l);
+		    else
+			for (i = 1; i < NSUBEXP; ++i)
+			    list_append_string(l, regmatch.startp[i] == NULL
+				  ? (char_u *)"" : regmatch.startp[i],
+				  regmatch.startp[i] == NULL ? 0
+				  : (int)(regmatch.endp[i] - regmatch.startp[i]));
+		}
+
+		/* Continue after the match, skip a character after an empty
+		 * match to avoid getting stuck. */
+		col = (colnr_T)(regmatch.endp[0] - line);
+		if (line[col] == NUL)
+		    break;
+		if (regmatch.endp[0] == regmatch.startp[0])
+		    col += MB_PTR2LEN(line + col);
+	    }
+	    line_breakcheck();
+	}
+	vim_regfree(regmatch.regprog);
+    }
+
+    p_cpo = save_cpo;
+}
+
 /*
  * "matchdelete()" function
  */
@@ -9486,6 +9635,7 @@ f_reverse(typval_T *argvars, typval_T *rettv)
 	li = l->lv_last;
 	l->lv_first = l->lv_last = NULL;
 	l->lv_len = 0;
+	l->lv_index_len = 0;
 	while (li != NULL)
 	{
 	    ni = li->li_prev;
@@ -9770,6 +9920,77 @@ f_search(typval_T *argvars, typval_T *rettv)
     rettv->vval.v_number = search_cmn(argvars, NULL, &flags);
 }
 
+/*
+ * "searchcount()" function
+ */
+    static void
+f_searchcount(typval_T *argvars, typval_T *rettv)
+{
+    char_u	*pat = NULL;
+    pos_T	pos = curwin->w_cursor;
+    int		recompute = FALSE;
+    long	time_limit = 100;
+    long	maxcount = 0;
+    long	current;
+    long	total;
+    int		exact;
+    int		incomplete;
+    dict_T	*d;
+    dictitem_T	*di;
+
+    if (rettv_dict_alloc(rettv) == FAIL)
+	return;
+
+    if (argvars[0].v_type != VAR_UNKNOWN)
+    {
+	if (argvars[0].v_type != VAR_DICT)
+	{
+	    EMSG(_(e_dictreq));
+	    return;
+	}
+	if ((d = argvars[0].vval.v_dict) != NULL)
+	{
+	    if (dict_find(d, (char_u *)"pattern", -1) != NULL)
+	    {
+		pat = get_dict_string(d, (char_u *)"pattern", FALSE);
+		if (pat == NULL)
+		    return;
+	    }
+	    di = dict_find(d, (char_u *)"pos", -1);
+	    if (di != NULL)
+	    {
+		if (list2fpos(&di->di_tv, &pos, NULL, NULL) == FAIL
+							     || pos.col == 0)
+		{
+		    EMSG2(_(e_invarg2), "pos");
+		    return;
+		}
+		--pos.col;
+	    }
+	    recompute = get_dict_number(d, (char_u *)"recompute") != 0;
+	    if (dict_find(d, (char_u *)"timeout", -1) != NULL)
+		time_limit = (long)get_dict_number(d, (char_u *)"timeout");
+	    maxcount = (long)get_dict_number(d, (char_u *)"maxcount");
+	    if (time_limit < 0 || maxcount < 0)
+	    {
+		EMSG2(_(e_invarg2), time_limit < 0 ? "timeout" : "maxcount");
+		return;
+	    }
+	}
+    }
+
+    incomplete = search_count(pat, &pos, recompute, time_limit, maxcount,
+					 &current, &total, &exact);
+    if (incomplete < 0)
+	return;
+
+    d = rettv->vval.v_dict;
+    dict_add_nr_str(d, "current", current, NULL);
+    dict_add_nr_str(d, "total", total, NULL);
+    dict_add_nr_str(d, "exact_match", exact, NULL);
+    dict_add_nr_str(d, "incomplete", incomplete, NULL);
+}
+
 /*
  * "searchdecl()" function
  */
@@ -11270,6 +11491,7 @@ do_sort_uniq(typval_T *argvars, typval_T *rettv, int sort)
 		    /* Clear the List and append the items in sorted order. */
 		    l->lv_first = l->lv_last = l->lv_idx_item = NULL;
 		    l->lv_len = 0;
+		    l->lv_index_len = 0;
 		    for (i = 0; i < len; ++i)
 			list_append(l, ptrs[i].item);
 		}
@@ -11301,6 +11523,8 @@ do_sort_uniq(typval_T *argvars, typval_T *rettv, int sort)
 
 	    if (!info.item_compare_func_err)
 	    {
+		l->lv_idx_item = NULL;
+		l->lv_index_len = 0;
 		while (--i >= 0)
 		{
 		    li = ptrs[i].item->li_next;
@@ -12074,7 +12298,7 @@ f_substitute(typval_T *argvars, typval_T *rettv)
     char_u	subbuf[NUMBUFLEN];
     char_u	flagsbuf[NUMBUFLEN];
 
-    char_u	*str = get_tv_string_chk(&argvars[0]);
+    char_u	*str = NULL;
     char_u	*pat = get_tv_string_buf_chk(&argvars[1], patbuf);
     char_u	*sub = NULL;
     typval_T	*expr = NULL;
@@ -12085,6 +12309,17 @@ f_substitute(typval_T *argvars, typval_T *rettv)
     else
 	sub = get_tv_string_buf_chk(&argvars[2], subbuf);
 
+    if (argvars[0].v_type == VAR_LIST)
+    {
+	/* Substitute in each item, compiling the pattern only once. */
+	if (rettv_list_alloc(rettv) == OK && argvars[0].vval.v_list != NULL
+		&& pat != NULL && (sub != NULL || expr != NULL) && flg != NULL)
+	    (void)do_list_sub(argvars[0].vval.v_list, pat, sub, expr, flg,
+							    rettv->vval.v_list);
+	return;
+    }
+
+    str = get_tv_string_chk(&argvars[0]);
     rettv->v_type = VAR_STRING;
     if (str == NULL || pat == NULL || (sub == NULL && expr == NULL)
 								|| flg == NULL)
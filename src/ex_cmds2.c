@@ -1606,6 +1606,33 @@ profile_divide(proftime_T *tm, int count, proftime_T *tm2)
 static void script_do_profile(scriptitem_T *si);
 static void script_dump_profile(FILE *fd);
 static proftime_T prof_wait_time;
+#  ifdef HAVE_PROF_SAMPLE
+#   define PROF_SAMPLE_MSEC 10	/* sample every 10 msec of CPU time */
+#   define PROF_RING_SIZE   512	/* number of entries in "prof_ring" */
+#   define PROF_STACK_LEN   256	/* longest sourcing_name that is recorded */
+
+/* Entry in the ring buffer, filled by the signal handler. */
+typedef struct
+{
+    long	ps_count;	/* number of samples, zero when not used */
+    linenr_T	ps_lnum;	/* sourcing_lnum */
+    int		ps_truncated;	/* ps_name has the tail of sourcing_name */
+    char_u	ps_name[PROF_STACK_LEN];    /* copy of sourcing_name */
+} profsample_T;
+
+/* Item in "prof_stacks": a stack and the number of samples for it. */
+typedef struct
+{
+    long	pst_count;
+    char_u	pst_stack[1];	/* actually longer */
+} profstack_T;
+
+#   define HIKEY2PST(p)  ((profstack_T *)(p - offsetof(profstack_T, pst_stack)))
+
+static void prof_sample_start(char_u *fname);
+static void prof_sample_add(profsample_T *ps);
+static void prof_sample_stop(void);
+#  endif
 
 /*
  * Add the time "tm2" to "tm".
@@ -1698,6 +1725,41 @@ profile_cmp(const proftime_T *tm1, const proftime_T *tm2)
 
 static char_u	*profile_fname = NULL;
 static proftime_T pause_time;
+static char_u	e_prof_sample[] = N_("E956: Cannot start sampling");
+
+#  ifdef HAVE_PROF_SAMPLE
+/*
+ * For ":profile sample" a timer signal records the value of sourcing_name and
+ * sourcing_lnum in "prof_ring".  prof_sample_fold() turns them into stacks
+ * and counts them in "prof_stacks".  When done the stacks are written in the
+ * "folded" format of flame graph tools: frames separated by ";" and the
+ * number of samples.
+ */
+static profsample_T	prof_ring[PROF_RING_SIZE];
+/* "prof_ring_head" is the entry the signal handler is filling, entries from
+ * "prof_ring_tail" up to it are waiting to be counted. */
+static volatile int	prof_ring_head = 0;
+static volatile int	prof_ring_tail = 0;
+static volatile long	prof_samples_dropped = 0;
+static volatile int	prof_sampling = FALSE;
+static char_u		*prof_sample_fname = NULL;
+static hashtab_T	prof_stacks;
+
+/* The signal handler must not look at sourcing_name, it is freed and replaced
+ * at any moment.  prof_sample_set_pos() copies it into the entry of "prof_pos"
+ * that the handler is not using and then increments "prof_pos_gen", the
+ * lowest bit of which selects the entry for the handler. */
+typedef struct
+{
+    size_t	pp_len;
+    linenr_T	pp_lnum;
+    int		pp_truncated;
+    char_u	pp_name[PROF_STACK_LEN];
+} profpos_T;
+
+static volatile profpos_T prof_pos[2];
+static volatile unsigned prof_pos_gen = 0;
+#  endif
 
 /*
  * ":profile cmd args"
@@ -1720,6 +1782,17 @@ ex_profile(exarg_T *eap)
 	profile_zero(&prof_wait_time);
 	set_vim_var_nr(VV_PROFILING, 1L);
     }
+    else if (len == 6 && STRNCMP(eap->arg, "sample", 6) == 0 && *e != NUL)
+    {
+#  ifdef HAVE_PROF_SAMPLE
+	if (STRCMP(e, "stop") != 0)
+	    prof_sample_start(e);
+	else if (prof_sampling)
+	    prof_sample_stop();
+#  else
+	EMSG(_(e_prof_sample));
+#  endif
+    }
     else if (do_profiling == PROF_NONE)
 	EMSG(_("E750: First use \":profile start {fname}\""));
     else if (STRCMP(eap->arg, "pause") == 0)
@@ -1762,8 +1835,10 @@ static char *pexpand_cmds[] = {
 #define PROFCMD_FUNC	3
 			"file",
 #define PROFCMD_FILE	4
+			"sample",
+#define PROFCMD_SAMPLE	5
 			NULL
-#define PROFCMD_LAST	5
+#define PROFCMD_LAST	6
 };
 
 /*
@@ -1800,7 +1875,8 @@ set_context_in_profile_cmd(expand_T *xp, char_u *arg)
     if (*end_subcmd == NUL)
 	return;
 
-    if (end_subcmd - arg == 5 && STRNCMP(arg, "start", 5) == 0)
+    if ((end_subcmd - arg == 5 && STRNCMP(arg, "start", 5) == 0)
+	    || (end_subcmd - arg == 6 && STRNCMP(arg, "sample", 6) == 0))
     {
 	xp->xp_context = EXPAND_FILES;
 	xp->xp_pattern = skipwhite(end_subcmd);
@@ -1831,8 +1907,266 @@ profile_dump(void)
 	    fclose(fd);
 	}
     }
+#  ifdef HAVE_PROF_SAMPLE
+    if (prof_sampling)
+	prof_sample_stop();
+#  endif
+}
+
+#  if defined(HAVE_PROF_SAMPLE) || defined(PROTO)
+/*
+ * ":profile sample {fname}": start sampling.
+ */
+    static void
+prof_sample_start(char_u *fname)
+{
+    if (prof_sampling)
+	prof_sample_stop();
+    prof_sample_fname = expand_env_save_opt(fname, TRUE);
+    if (prof_sample_fname == NULL)
+	return;
+    hash_init(&prof_stacks);
+    vim_memset(prof_ring, 0, sizeof(prof_ring));
+    prof_ring_head = 0;
+    prof_ring_tail = 0;
+    prof_samples_dropped = 0;
+    prof_sampling = TRUE;
+    prof_sample_set_pos();
+    if (mch_prof_sample_timer(PROF_SAMPLE_MSEC) == FAIL)
+    {
+	prof_sampling = FALSE;
+	VIM_CLEAR(prof_sample_fname);
+	EMSG(_(e_prof_sample));
+    }
+}
+
+/*
+ * Make the current position available to the ":profile sample" signal
+ * handler.  Called for every executed command and when returning from a
+ * function or sourced script.
+ */
+    void
+prof_sample_set_pos(void)
+{
+    char_u		*name = sourcing_name;
+    volatile profpos_T	*pp = &prof_pos[(prof_pos_gen + 1) & 1];
+    size_t		len;
+    size_t		i;
+
+    if (!prof_sampling)
+	return;
+    if (name == NULL)
+	/* Not executing a script. */
+	name = (char_u *)"";
+    len = STRLEN(name);
+
+    pp->pp_truncated = len >= PROF_STACK_LEN;
+    if (pp->pp_truncated)
+    {
+	/* Keep the innermost functions. */
+	name += len - (PROF_STACK_LEN - 1);
+	len = PROF_STACK_LEN - 1;
+    }
+    for (i = 0; i <= len; ++i)
+	pp->pp_name[i] = name[i];
+    pp->pp_len = len;
+    pp->pp_lnum = sourcing_name == NULL ? 0 : sourcing_lnum;
+    ++prof_pos_gen;
+}
+
+/*
+ * Record a sample for ":profile sample".
+ * Called from a signal handler: must not allocate memory or use any function
+ * that isn't async-signal-safe.  Only uses the position stored by
+ * prof_sample_set_pos().  When the position is the same as for the previous
+ * sample only its count is incremented, so that a long running command uses
+ * one entry.
+ */
+    void
+prof_sample_record(void)
+{
+    profsample_T	*ps;
+    volatile profpos_T	*pp = &prof_pos[prof_pos_gen & 1];
+    linenr_T		lnum = pp->pp_lnum;
+    int			truncated = pp->pp_truncated;
+    int			head = prof_ring_head;
+    size_t		len = pp->pp_len;
+    size_t		i;
+
+    if (!prof_sampling)
+	return;
+
+    ps = &prof_ring[head];
+    if (ps->ps_count > 0)
+    {
+	if (ps->ps_lnum == lnum && ps->ps_truncated == truncated)
+	{
+	    for (i = 0; i <= len; ++i)
+		if (ps->ps_name[i] != pp->pp_name[i])
+		    break;
+	    if (i > len)
+	    {
+		++ps->ps_count;
+		return;
+	    }
+	}
+	if ((head + 1) % PROF_RING_SIZE == prof_ring_tail)
+	{
+	    /* Ring buffer is full. */
+	    ++prof_samples_dropped;
+	    return;
+	}
+	head = (head + 1) % PROF_RING_SIZE;
+	ps = &prof_ring[head];
+	prof_ring_head = head;
+    }
+    for (i = 0; i <= len; ++i)
+	ps->ps_name[i] = pp->pp_name[i];
+    ps->ps_lnum = lnum;
+    ps->ps_truncated = truncated;
+    ps->ps_count = 1;
+
+    /* Ask for the ring buffer to be emptied when it's half full. */
+    if ((head - prof_ring_tail + PROF_RING_SIZE) % PROF_RING_SIZE
+							 >= PROF_RING_SIZE / 2)
+	prof_sample_pending = TRUE;
 }
 
+/*
+ * Count the samples in the ring buffer that the signal handler is done with.
+ */
+    void
+prof_sample_fold(void)
+{
+    profsample_T    *ps;
+
+    prof_sample_pending = FALSE;
+    while (prof_ring_tail != prof_ring_head)
+    {
+	ps = &prof_ring[prof_ring_tail];
+	prof_sample_add(ps);
+	ps->ps_count = 0;
+	prof_ring_tail = (prof_ring_tail + 1) % PROF_RING_SIZE;
+    }
+}
+
+/*
+ * Add the samples of "ps" to "prof_stacks".
+ * "function Outer[12]..Inner" with line 3 becomes "Outer:12;Inner:3".
+ */
+    static void
+prof_sample_add(profsample_T *ps)
+{
+    char_u	buf[PROF_STACK_LEN + NUMBUFLEN + 5];
+    char_u	*p = ps->ps_name;
+    char_u	*d = buf;
+    int		is_func;
+    profstack_T	*pst;
+    hashitem_T	*hi;
+    hash_T	hash;
+
+    is_func = ps->ps_truncated || STRNCMP(p, "function ", 9) == 0;
+    if (ps->ps_truncated)
+    {
+	/* Skip the partial frame. */
+	p = (char_u *)strstr((char *)p, "..");
+	p = p == NULL ? ps->ps_name : p + 2;
+	STRCPY(d, "...;");
+	d += 4;
+    }
+    else if (is_func)
+	p += 9;
+    if (*p == NUL)
+    {
+	STRCPY(d, "(none)");
+	d += STRLEN(d);
+    }
+    while (*p != NUL)
+    {
+	if (is_func && p[0] == '.' && p[1] == '.')
+	{
+	    *d++ = ';';
+	    p += 2;
+	}
+	else if (is_func && *p == '[')
+	{
+	    *d++ = ':';
+	    ++p;
+	}
+	else if (is_func && *p == ']')
+	    ++p;
+	else if (*p == ';')
+	{
+	    /* ";" separates frames */
+	    *d++ = ',';
+	    ++p;
+	}
+	else
+	    *d++ = *p++;
+    }
+    if (ps->ps_lnum > 0)
+	sprintf((char *)d, ":%ld", (long)ps->ps_lnum);
+    else
+	*d = NUL;
+
+    hash = hash_hash(buf);
+    hi = hash_lookup(&prof_stacks, buf, hash);
+    if (HASHITEM_EMPTY(hi))
+    {
+	pst = (profstack_T *)alloc((unsigned)(sizeof(profstack_T)
+							       + STRLEN(buf)));
+	if (pst == NULL)
+	    return;
+	STRCPY(pst->pst_stack, buf);
+	pst->pst_count = 0;
+	hash_add_item(&prof_stacks, hi, pst->pst_stack, hash);
+    }
+    else
+	pst = HIKEY2PST(hi->hi_key);
+    pst->pst_count += ps->ps_count;
+}
+
+/*
+ * Stop ":profile sample" and write the stacks to the file.
+ */
+    static void
+prof_sample_stop(void)
+{
+    FILE	*fd;
+    hashitem_T	*hi;
+    int		todo;
+
+    (void)mch_prof_sample_timer(0L);
+    prof_sampling = FALSE;
+    prof_sample_fold();
+    if (prof_ring[prof_ring_head].ps_count > 0)
+    {
+	prof_sample_add(&prof_ring[prof_ring_head]);
+	prof_ring[prof_ring_head].ps_count = 0;
+    }
+
+    fd = mch_fopen((char *)prof_sample_fname, "w");
+    if (fd == NULL)
+	EMSG2(_(e_notopen), prof_sample_fname);
+    else
+    {
+	todo = (int)prof_stacks.ht_used;
+	for (hi = prof_stacks.ht_array; todo > 0; ++hi)
+	    if (!HASHITEM_EMPTY(hi))
+	    {
+		--todo;
+		fprintf(fd, "%s %ld\n", hi->hi_key,
+					   HIKEY2PST(hi->hi_key)->pst_count);
+	    }
+	if (prof_samples_dropped > 0)
+	    fprintf(fd, "(dropped) %ld\n", prof_samples_dropped);
+	fclose(fd);
+    }
+    hash_clear_all(&prof_stacks, offsetof(profstack_T, pst_stack));
+    VIM_CLEAR(prof_sample_fname);
+}
+#  endif
+
 /*
  * Start profiling script "fp".
  */
@@ -4657,6 +4991,9 @@ do_source(
 	EMSG(_(e_interr));
     sourcing_name = save_sourcing_name;
     sourcing_lnum = save_sourcing_lnum;
+#ifdef HAVE_PROF_SAMPLE
+    prof_sample_set_pos();
+#endif
     if (p_verbose > 1)
     {
 	verbose_enter();
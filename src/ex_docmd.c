@@ -63,9 +63,9 @@ static char_u *get_user_command_name(int idx);
 
 static int compute_buffer_local_count(int addr_type, int lnum, int local);
 #ifdef FEAT_EVAL
-static char_u	*do_one_cmd(char_u **, int, struct condstack *, char_u *(*fgetline)(int, void *, int), void *cookie);
+static char_u	*do_one_cmd(char_u **, int, struct condstack *, char_u *(*fgetline)(int, void *, int), void *cookie, cmdparse_T *parsed);
 #else
-static char_u	*do_one_cmd(char_u **, int, char_u *(*fgetline)(int, void *, int), void *cookie);
+static char_u	*do_one_cmd(char_u **, int, char_u *(*fgetline)(int, void *, int), void *cookie, cmdparse_T *parsed);
 static int	if_level = 0;		/* depth in :if */
 #endif
 static void	append_command(char_u *cmd);
@@ -467,6 +467,7 @@ typedef struct
 {
     char_u	*line;		/* command line */
     linenr_T	lnum;		/* sourcing_lnum of the line */
+    cmdparse_T	parsed;		/* parsed command, used when repeating */
 } wcmd_T;
 
 /*
@@ -683,6 +684,7 @@ do_cmdline(
     int		count = 0;		/* line number count */
     int		did_inc = FALSE;	/* incremented RedrawingDisabled */
     int		retval = OK;
+    cmdparse_T	*cmd_parsed;		/* parsed command for cmdline_copy */
 #ifdef FEAT_EVAL
     struct condstack cstack;		/* conditional stack */
     garray_T	lines_ga;		/* keep lines for ":while"/":for" */
@@ -838,6 +840,7 @@ do_cmdline(
 	 * 2. If no line given: Get an allocated line with fgetline().
 	 * 3. If a line is given: Make a copy, so we can mess with it.
 	 */
+	cmd_parsed = NULL;
 
 #ifdef FEAT_EVAL
 	/* 1. If repeating, get a previous line from lines_ga. */
@@ -886,6 +889,7 @@ do_cmdline(
 
 	    next_cmdline = ((wcmd_T *)(lines_ga.ga_data))[current_line].line;
 	    sourcing_lnum = ((wcmd_T *)(lines_ga.ga_data))[current_line].lnum;
+	    cmd_parsed = &((wcmd_T *)(lines_ga.ga_data))[current_line].parsed;
 
 	    /* Did we encounter a breakpoint? */
 	    if (breakpoint != NULL && *breakpoint != 0
@@ -957,6 +961,11 @@ do_cmdline(
 		break;
 	    }
 	    used_getline = TRUE;
+#ifdef FEAT_EVAL
+	    /* A function line only needs to be parsed once. */
+	    if (fgetline == get_func_line)
+		cmd_parsed = func_line_parsed(cookie);
+#endif
 
 	    /*
 	     * Keep the first typed line.  Clear it when more lines are typed.
@@ -1000,6 +1009,10 @@ do_cmdline(
 		retval = FAIL;
 		break;
 	    }
+	    /* Parse the line only once, it is executed again when looping. */
+	    if (cmd_parsed == NULL)
+		cmd_parsed = &((wcmd_T *)(lines_ga.ga_data))
+						[lines_ga.ga_len - 1].parsed;
 	}
 	did_endif = FALSE;
 #endif
@@ -1048,7 +1061,7 @@ do_cmdline(
 #ifdef FEAT_EVAL
 				&cstack,
 #endif
-				cmd_getline, cmd_cookie);
+				cmd_getline, cmd_cookie, cmd_parsed);
 	--recursive;
 
 #ifdef FEAT_EVAL
@@ -1515,6 +1528,7 @@ store_loop_line(garray_T *gap, char_u *line)
 	return FAIL;
     ((wcmd_T *)(gap->ga_data))[gap->ga_len].line = vim_strsave(line);
     ((wcmd_T *)(gap->ga_data))[gap->ga_len].lnum = sourcing_lnum;
+    ((wcmd_T *)(gap->ga_data))[gap->ga_len].parsed.cp_state = CP_UNKNOWN;
     ++gap->ga_len;
     return OK;
 }
@@ -1708,7 +1722,8 @@ do_one_cmd(
     struct condstack	*cstack,
 #endif
     char_u		*(*fgetline)(int, void *, int),
-    void		*cookie)		/* argument for fgetline() */
+    void		*cookie,		/* argument for fgetline() */
+    cmdparse_T		*parsed)		/* parsed command or NULL */
 {
     char_u		*p;
     linenr_T		lnum;
@@ -1752,6 +1767,13 @@ do_one_cmd(
     save_cmdmod = cmdmod;
     vim_memset(&cmdmod, 0, sizeof(cmdmod));
 
+    if (parsed != NULL && parsed->cp_state == CP_CACHED)
+    {
+	/* Parsed this line before, there are no modifiers. */
+	ea.cmd = *cmdlinep + parsed->cp_cmd;
+	goto parsed_modifiers;
+    }
+
     /* "#!anything" is handled like a comment. */
     if ((*cmdlinep)[0] == '#' && (*cmdlinep)[1] == '!')
 	goto doend;
@@ -1980,6 +2002,7 @@ do_one_cmd(
 	}
 	break;
     }
+parsed_modifiers:
     after_modifier = ea.cmd;
 
 #ifdef FEAT_EVAL
@@ -1999,6 +2022,12 @@ do_one_cmd(
 	else if (getline_equal(fgetline, cookie, getsourceline))
 	    script_line_exec();
     }
+#  ifdef HAVE_PROF_SAMPLE
+    prof_sample_set_pos();
+    /* Count ":profile sample" samples before the ring buffer fills up. */
+    if (prof_sample_pending)
+	prof_sample_fold();
+#  endif
 #endif
 
     /* May go to debug mode.  If this happens and the ">quit" debug command is
@@ -2017,10 +2046,38 @@ do_one_cmd(
  * We need the command to know what kind of range it uses.
  */
     cmd = ea.cmd;
-    ea.cmd = skip_range(ea.cmd, NULL);
-    if (*ea.cmd == '*' && vim_strchr(p_cpo, CPO_STAR) == NULL)
-	ea.cmd = skipwhite(ea.cmd + 1);
-    p = find_command(&ea, NULL);
+    if (parsed != NULL && parsed->cp_state == CP_CACHED)
+    {
+	ea.cmdidx = (cmdidx_T)parsed->cp_cmdidx;
+	p = *cmdlinep + parsed->cp_arg;
+    }
+    else
+    {
+	ea.cmd = skip_range(ea.cmd, NULL);
+	if (*ea.cmd == '*' && vim_strchr(p_cpo, CPO_STAR) == NULL)
+	    ea.cmd = skipwhite(ea.cmd + 1);
+	p = find_command(&ea, NULL);
+
+	if (parsed != NULL && parsed->cp_state == CP_UNKNOWN)
+	{
+	    char_u	*s = *cmdlinep;
+
+	    /* Remember the command when there is no modifier and no range
+	     * and it is a builtin command. */
+	    while (*s == ' ' || *s == '\t' || *s == ':')
+		++s;
+	    if (s == cmd && ea.cmd == cmd && ASCII_ISLOWER(*cmd) && p != NULL
+		    && ea.cmdidx != CMD_SIZE && !IS_USER_CMDIDX(ea.cmdidx))
+	    {
+		parsed->cp_cmdidx = (int)ea.cmdidx;
+		parsed->cp_cmd = (int)(cmd - *cmdlinep);
+		parsed->cp_arg = (int)(p - *cmdlinep);
+		parsed->cp_state = CP_CACHED;
+	    }
+	    else
+		parsed->cp_state = CP_NOCACHE;
+	}
+    }
 
 /*
  * 4. parse a range specifier of the form: addr [,addr] [;addr] ..
@@ -238,6 +238,10 @@ EXTERN int	debug_tick INIT(= 0);		/* breakpoint change count */
 EXTERN int	debug_backtrace_level INIT(= 0); /* breakpoint backtrace level */
 # ifdef FEAT_PROFILE
 EXTERN int	do_profiling INIT(= PROF_NONE);	/* PROF_ values */
+#  ifdef HAVE_PROF_SAMPLE
+/* volatile because it is used in signal handler sig_prof_sample(). */
+EXTERN volatile int prof_sample_pending INIT(= FALSE);
+#  endif
 # endif
 
 /*
@@ -320,10 +324,14 @@ EXTERN except_T *caught_stack INIT(= NULL);
  * "want_garbage_collect" is set by the garbagecollect() function, which means
  * we do garbage collection before waiting for a char at the toplevel.
  * "garbage_collect_at_exit" indicates garbagecollect(1) was called.
+ * "may_have_garbage" is set when a reference to a List, Dictionary or Partial
+ * was removed without freeing it, thus a cycle may have become unreachable.
+ * When it is not set the garbage collection while waiting is skipped.
  */
 EXTERN int	may_garbage_collect INIT(= FALSE);
 EXTERN int	want_garbage_collect INIT(= FALSE);
 EXTERN int	garbage_collect_at_exit INIT(= FALSE);
+EXTERN int	may_have_garbage INIT(= TRUE);
 
 /* ID of script being sourced or was sourced to define the current function. */
 EXTERN scid_T	current_SID INIT(= 0);
@@ -470,9 +470,18 @@ hash_hash(char_u *key)
     p = key + 1;
 
     /* A simplistic algorithm that appears to do very well.
-     * Suggested by George Reilly. */
-    while (*p != NUL)
-	hash = hash * 101 + *p++;
+     * Suggested by George Reilly.
+     * This is "hash = hash * 101 + *p++" for each byte, done for two bytes
+     * at a time, so that the multiplications don't depend on each other.
+     * The result must not change, the order of items in a Dictionary
+     * depends on it. */
+    while (p[0] != NUL)
+    {
+	if (p[1] == NUL)
+	    return hash * 101 + p[0];
+	hash = hash * (101 * 101) + (hash_T)p[0] * 101 + p[1];
+	p += 2;
+    }
 
     return hash;
 }
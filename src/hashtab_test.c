@@ -0,0 +1,118 @@
+/* vi:set ts=8 sts=4 sw=4 noet:
+ *
+ * VIM - Vi IMproved	by Bram Moolenaar
+ *
+ * Do ":help uganda"  in Vim to read copying and usage conditions.
+ * Do ":help credits" in Vim to see a list of people who contributed.
+ * See README.txt for an overview of the Vim source code.
+ */
+
+/*
+ * hashtab_test.c: Unittests for hashtab.c.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+
+/* Must include main.c because it contains much more than just main() */
+#define NO_VIM_MAIN
+#include "main.c"
+
+#define KEY_COUNT   1000
+#define KEY_LEN	    40
+
+static char_u	keys[KEY_COUNT][KEY_LEN];
+
+/*
+ * The hash function as it was computed one byte at a time.  hash_hash() must
+ * return the same values, the order of items in a Dictionary depends on it.
+ */
+    static hash_T
+hash_hash_ref(char_u *key)
+{
+    hash_T	hash;
+    char_u	*p;
+
+    if ((hash = *key) == 0)
+	return (hash_T)0;
+    for (p = key + 1; *p != NUL; ++p)
+	hash = hash * 101 + *p;
+    return hash;
+}
+
+/*
+ * Fill "keys" with names that look like variable names.
+ */
+    static void
+init_keys(void)
+{
+    static char	*names[] = {"a", "i", "idx", "line", "result", "lnum",
+		       "current_buffer_name", "foo_bar_baz", "x", "\303\251t\303\251"};
+    int		i;
+
+    for (i = 0; i < KEY_COUNT; ++i)
+	vim_snprintf((char *)keys[i], KEY_LEN, "%s%d", names[i % 10], i / 10);
+}
+
+/*
+ * Test that hash_hash() returns the same values as the byte loop.
+ */
+    static void
+test_hash_hash(void)
+{
+    char_u	buf[KEY_LEN];
+    int		len;
+    int		i;
+
+    assert(hash_hash((char_u *)"") == 0);
+    for (i = 0; i < KEY_COUNT; ++i)
+	assert(hash_hash(keys[i]) == hash_hash_ref(keys[i]));
+
+    /* all lengths, odd and even */
+    for (len = 0; len < KEY_LEN - 1; ++len)
+    {
+	buf[len] = (char_u)(0xff - len);
+	buf[len + 1] = NUL;
+	assert(hash_hash(buf) == hash_hash_ref(buf));
+    }
+}
+
+/*
+ * Test adding, finding and removing items.
+ */
+    static void
+test_hash_add_find(void)
+{
+    hashtab_T	ht;
+    hashitem_T	*hi;
+    int		i;
+
+    hash_init(&ht);
+    for (i = 0; i < KEY_COUNT; ++i)
+	assert(hash_add(&ht, keys[i]) == OK);
+    assert(ht.ht_used == KEY_COUNT);
+
+    for (i = 0; i < KEY_COUNT; ++i)
+    {
+	hi = hash_find(&ht, keys[i]);
+	assert(!HASHITEM_EMPTY(hi));
+	assert(hi->hi_key == keys[i]);
+    }
+    assert(HASHITEM_EMPTY(hash_find(&ht, (char_u *)"nothere")));
+
+    for (i = 0; i < KEY_COUNT; i += 2)
+	hash_remove(&ht, hash_find(&ht, keys[i]));
+    for (i = 0; i < KEY_COUNT; ++i)
+	assert(HASHITEM_EMPTY(hash_find(&ht, keys[i])) == (i % 2 == 0));
+
+    hash_clear(&ht);
+}
+
+    int
+main(void)
+{
+    init_keys();
+    test_hash_hash();
+    test_hash_add_find();
+    return 0;
+}
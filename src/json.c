@@ -19,7 +19,7 @@
 #if defined(FEAT_EVAL) || defined(PROTO)
 
 static int json_encode_item(garray_T *gap, typval_T *val, int copyID, int options);
-static int json_decode_item(js_read_T *reader, typval_T *res, int options);
+static int json_decode_item(js_read_T *reader, typval_T *res, int options, json_partial_T *partial);
 
 /*
  * Encode "val" into a JSON format string.
@@ -85,10 +85,52 @@ json_encode_nr_expr(int nr, typval_T *val, int options)
     return ga.ga_data;
 }
 
+/* A long_u with every byte set to "c". */
+#define JSON_BYTES(c)	(((long_u)-1 / 0xff) * (c))
+
+/*
+ * Return the number of bytes from "p" that can be copied as they are: ASCII
+ * characters that are not a control character, '"', '\' or "quote".  "end"
+ * must not be after the NUL.
+ * Checks a word at a time, most text in a message has nothing special.
+ */
+    static long
+json_plain_len(char_u *p, char_u *end, int quote)
+{
+    char_u	*s = p;
+    long_u	w;
+    long_u	special;
+
+    while (end - s >= (long)sizeof(long_u))
+    {
+	mch_memmove(&w, s, sizeof(long_u));
+	/* Set the high bit of each byte that is below 0x20 or 0x80 and above,
+	 * or has the value of '"', '\' or "quote".  Borrows can only give
+	 * false positives after a byte that already matched. */
+	special = ((w - JSON_BYTES(0x20)) & ~w)
+		| (((w ^ JSON_BYTES('"')) - JSON_BYTES(1))
+						 & ~(w ^ JSON_BYTES('"')))
+		| (((w ^ JSON_BYTES('\\')) - JSON_BYTES(1))
+						 & ~(w ^ JSON_BYTES('\\')))
+		| (((w ^ JSON_BYTES(quote)) - JSON_BYTES(1))
+						 & ~(w ^ JSON_BYTES(quote)))
+		| w;
+	if ((special & JSON_BYTES(0x80)) != 0)
+	    break;
+	s += sizeof(long_u);
+    }
+    while (s < end && *s >= 0x20 && *s < 0x80
+			     && *s != '"' && *s != '\\' && *s != quote)
+	++s;
+    return (long)(s - p);
+}
+
     static void
 write_string(garray_T *gap, char_u *str)
 {
     char_u	*res = str;
+    char_u	*end;
+    long	len;
     char_u	numbuf[NUMBUFLEN];
 
     if (res == NULL)
@@ -110,10 +152,26 @@ write_string(garray_T *gap, char_u *str)
 	    convert_setup(&conv, NULL, NULL);
 	}
 #endif
+	end = res + STRLEN(res);
+	/* Usually nothing needs to be escaped, allocate for that at once. */
+	(void)ga_grow(gap, (int)(end - res) + 2);
 	ga_append(gap, '"');
 	while (*res != NUL)
 	{
 	    int c;
+
+	    /* Copy a sequence of plain characters at once. */
+	    len = json_plain_len(res, end, '"');
+	    if (len > 0)
+	    {
+		if (ga_grow(gap, (int)len) == FAIL)
+		    break;
+		mch_memmove((char *)gap->ga_data + gap->ga_len, res,
+								 (size_t)len);
+		gap->ga_len += (int)len;
+		res += len;
+		continue;
+	    }
 #ifdef FEAT_MBYTE
 	    /* always use utf-8 encoding, ignore 'encoding' */
 	    c = utf_ptr2char(res);
@@ -357,11 +415,23 @@ fill_numbuflen(js_read_T *reader)
     static void
 json_skip_white(js_read_T *reader)
 {
-    int c;
+    int		c;
+    long_u	w;
 
     for (;;)
     {
 	c = reader->js_buf[reader->js_used];
+	if (c == ' ' && reader->js_end - (reader->js_buf + reader->js_used)
+						    >= (long)sizeof(long_u))
+	{
+	    /* Skip indent a word at a time. */
+	    mch_memmove(&w, reader->js_buf + reader->js_used, sizeof(long_u));
+	    if (w == JSON_BYTES(' '))
+	    {
+		reader->js_used += sizeof(long_u);
+		continue;
+	    }
+	}
 	if (reader->js_fill != NULL && c == NUL)
 	{
 	    if (reader->js_fill(reader))
@@ -382,6 +452,7 @@ json_decode_string(js_read_T *reader, typval_T *res, int quote)
 {
     garray_T    ga;
     int		len;
+    long	plain_len;
     char_u	*p;
     int		c;
     varnumber_T	nr;
@@ -392,6 +463,25 @@ json_decode_string(js_read_T *reader, typval_T *res, int quote)
     p = reader->js_buf + reader->js_used + 1; /* skip over " or ' */
     while (*p != quote)
     {
+	/* Copy a sequence of plain characters at once. */
+	plain_len = json_plain_len(p, reader->js_end, quote);
+	if (plain_len > 0)
+	{
+	    if (res != NULL)
+	    {
+		if (ga_grow(&ga, (int)plain_len) == FAIL)
+		{
+		    ga_clear(&ga);
+		    return FAIL;
+		}
+		mch_memmove((char *)ga.ga_data + ga.ga_len, p,
+							   (size_t)plain_len);
+		ga.ga_len += (int)plain_len;
+	    }
+	    p += plain_len;
+	    continue;
+	}
+
 	/* The JSON is always expected to be utf-8, thus use utf functions
 	 * here. The string is converted below if needed. */
 	if (*p == NUL || p[1] == NUL
@@ -553,47 +643,88 @@ typedef struct {
     typval_T	  jd_tv;	/* the list or dict */
     typval_T	  jd_key_tv;
     char_u	  *jd_key;
+    int		  jd_need_sep;	/* item was added, expecting ',' or ':' */
 } json_dec_item_T;
 
 /*
  * Decode one item and put it in "res".  If "res" is NULL only advance.
  * Must already have skipped white space.
+ * When "partial" is not NULL the text may end anywhere: "res" is not used,
+ * the value is decoded into partial->jp_res and the lists and dicts that are
+ * not complete yet are kept in partial->jp_stack.  The text up to
+ * reader->js_used has then been decoded and a following call continues with
+ * the text after it.
  *
  * Return FAIL for a decoding error (and give an error).
  * Return MAYBE for an incomplete message.
  */
     static int
-json_decode_item(js_read_T *reader, typval_T *res, int options)
+json_decode_item(
+	js_read_T	*reader,
+	typval_T	*res,
+	int		options,
+	json_partial_T	*partial)
 {
     char_u	*p;
     int		len;
     int		retval;
-    garray_T	stack;
+    garray_T	stack_ga;
+    garray_T	*stack = &stack_ga;
     typval_T	item;
     typval_T	*cur_item;
     json_dec_item_T *top_item;
     char_u	key_buf[NUMBUFLEN];
+    int		start_used;
 
-    ga_init2(&stack, sizeof(json_dec_item_T), 100);
-    cur_item = res;
     init_tv(&item);
-    if (res != NULL)
-    init_tv(res);
+    if (partial != NULL)
+    {
+	stack = &partial->jp_stack;
+	res = &partial->jp_res;
+    }
+    else
+	ga_init2(stack, sizeof(json_dec_item_T), 100);
+    cur_item = res;
+
+    if (partial != NULL && stack->ga_len > 0)
+    {
+	/* Continue where the previous call stopped. */
+	top_item = ((json_dec_item_T *)stack->ga_data) + stack->ga_len - 1;
+	if (top_item->jd_type == (top_item->jd_need_sep
+					     ? JSON_OBJECT_KEY : JSON_OBJECT))
+	    top_item->jd_key = get_tv_string_buf_chk(&top_item->jd_key_tv,
+								      key_buf);
+	if (top_item->jd_need_sep)
+	{
+	    cur_item = top_item->jd_type == JSON_OBJECT
+					  ? &top_item->jd_key_tv : &item;
+	    goto item_sep;
+	}
+	cur_item = top_item->jd_type == JSON_OBJECT_KEY
+					  ? &top_item->jd_key_tv : &item;
+    }
+    else
+    {
+	if (partial != NULL)
+	    ga_init2(stack, sizeof(json_dec_item_T), 100);
+	if (res != NULL)
+	    init_tv(res);
+    }
 
     fill_numbuflen(reader);
     p = reader->js_buf + reader->js_used;
     for (;;)
     {
 	top_item = NULL;
-	if (stack.ga_len > 0)
+	if (stack->ga_len > 0)
 	{
-	    top_item = ((json_dec_item_T *)stack.ga_data) + stack.ga_len - 1;
+	    top_item = ((json_dec_item_T *)stack->ga_data) + stack->ga_len - 1;
 	    json_skip_white(reader);
 	    p = reader->js_buf + reader->js_used;
 	    if (*p == NUL)
 	    {
 		retval = MAYBE;
-		if (top_item->jd_type == JSON_OBJECT)
+		if (top_item->jd_type == JSON_OBJECT && partial == NULL)
 		    /* did get the key, clear it */
 		    clear_tv(&top_item->jd_key_tv);
 		goto theend;
@@ -605,8 +736,8 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		if (*p == (top_item->jd_type == JSON_ARRAY ? ']' : '}'))
 		{
 		    ++reader->js_used; /* consume the ']' or '}' */
-		    --stack.ga_len;
-		    if (stack.ga_len == 0)
+		    --stack->ga_len;
+		    if (stack->ga_len == 0)
 		    {
 			retval = OK;
 			goto theend;
@@ -618,6 +749,9 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 	    }
 	}
 
+	/* Where to go back to when an item is incomplete. */
+	start_used = reader->js_used;
+
 	if (top_item != NULL && top_item->jd_type == JSON_OBJECT_KEY
 		&& (options & JSON_JS)
 		&& reader->js_buf[reader->js_used] != '"'
@@ -631,6 +765,11 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 	    key = p = reader->js_buf + reader->js_used;
 	    while (*p != NUL && *p != ':' && *p > ' ')
 		++p;
+	    if (*p == NUL && partial != NULL)
+	    {
+		retval = MAYBE;
+		goto theend;
+	    }
 	    if (cur_item != NULL)
 	    {
 		cur_item->v_type = VAR_STRING;
@@ -649,7 +788,7 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 			retval = FAIL;
 			break;
 		    }
-		    if (ga_grow(&stack, 1) == FAIL)
+		    if (ga_grow(stack, 1) == FAIL)
 		    {
 			retval = FAIL;
 			break;
@@ -663,10 +802,11 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		    }
 
 		    ++reader->js_used; /* consume the '[' */
-		    top_item = ((json_dec_item_T *)stack.ga_data)
-								+ stack.ga_len;
+		    top_item = ((json_dec_item_T *)stack->ga_data)
+							       + stack->ga_len;
 		    top_item->jd_type = JSON_ARRAY;
-		    ++stack.ga_len;
+		    top_item->jd_need_sep = FALSE;
+		    ++stack->ga_len;
 		    if (cur_item != NULL)
 		    {
 			top_item->jd_tv = *cur_item;
@@ -680,7 +820,7 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 			retval = FAIL;
 			break;
 		    }
-		    if (ga_grow(&stack, 1) == FAIL)
+		    if (ga_grow(stack, 1) == FAIL)
 		    {
 			retval = FAIL;
 			break;
@@ -694,10 +834,11 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		    }
 
 		    ++reader->js_used; /* consume the '{' */
-		    top_item = ((json_dec_item_T *)stack.ga_data)
-								+ stack.ga_len;
+		    top_item = ((json_dec_item_T *)stack->ga_data)
+							       + stack->ga_len;
 		    top_item->jd_type = JSON_OBJECT_KEY;
-		    ++stack.ga_len;
+		    top_item->jd_need_sep = FALSE;
+		    ++stack->ga_len;
 		    if (cur_item != NULL)
 		    {
 			top_item->jd_tv = *cur_item;
@@ -737,6 +878,23 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 		    break;
 
 		default:
+		    if (partial != NULL && stack->ga_len > 0
+					     && (VIM_ISDIGIT(*p) || *p == '-'))
+		    {
+			char_u	*ep = p;
+
+			/* When the text ends in the number more digits or the
+			 * exponent may follow. */
+			while (*ep != NUL
+				    && vim_strchr((char_u *)"0123456789.eE+-",
+								*ep) != NULL)
+			    ++ep;
+			if (*ep == NUL)
+			{
+			    retval = MAYBE;
+			    break;
+			}
+		    }
 		    if (VIM_ISDIGIT(*p) || *p == '-')
 		    {
 #ifdef FEAT_FLOAT
@@ -868,7 +1026,15 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 	     * toplevel. */
 	    if (retval == FAIL)
 		break;
-	    if (retval == MAYBE || stack.ga_len == 0)
+	    if (retval == MAYBE && partial != NULL)
+	    {
+		/* Decode the incomplete item again when there is more.  Any
+		 * allocated value was already freed. */
+		if (cur_item != NULL)
+		    init_tv(cur_item);
+		reader->js_used = start_used;
+	    }
+	    if (retval == MAYBE || stack->ga_len == 0)
 		goto theend;
 
 	    if (top_item != NULL && top_item->jd_type == JSON_OBJECT_KEY
@@ -886,7 +1052,7 @@ json_decode_item(js_read_T *reader, typval_T *res, int options)
 	}
 
 item_end:
-	top_item = ((json_dec_item_T *)stack.ga_data) + stack.ga_len - 1;
+	top_item = ((json_dec_item_T *)stack->ga_data) + stack->ga_len - 1;
 	switch (top_item->jd_type)
 	{
 	    case JSON_ARRAY:
@@ -905,45 +1071,9 @@ item_end:
 		}
 		if (cur_item != NULL)
 		    cur_item = &item;
-
-		json_skip_white(reader);
-		p = reader->js_buf + reader->js_used;
-		if (*p == ',')
-		    ++reader->js_used;
-		else if (*p != ']')
-		{
-		    if (*p == NUL)
-			retval = MAYBE;
-		    else
-		    {
-			EMSG(_(e_invarg));
-			retval = FAIL;
-		    }
-		    goto theend;
-		}
 		break;
 
 	    case JSON_OBJECT_KEY:
-		json_skip_white(reader);
-		p = reader->js_buf + reader->js_used;
-		if (*p != ':')
-		{
-		    if (cur_item != NULL)
-			clear_tv(cur_item);
-		    if (*p == NUL)
-			retval = MAYBE;
-		    else
-		    {
-			EMSG(_(e_invarg));
-			retval = FAIL;
-		    }
-		    goto theend;
-		}
-		++reader->js_used;
-		json_skip_white(reader);
-		top_item->jd_type = JSON_OBJECT;
-		if (cur_item != NULL)
-		    cur_item = &item;
 		break;
 
 	    case JSON_OBJECT:
@@ -979,9 +1109,56 @@ item_end:
 			goto theend;
 		    }
 		}
+		if (cur_item != NULL)
+		    cur_item = &top_item->jd_key_tv;
+		break;
+	}
+	top_item->jd_need_sep = TRUE;
+
+item_sep:
+	/* The item was added, check for the separator. */
+	json_skip_white(reader);
+	p = reader->js_buf + reader->js_used;
+	switch (top_item->jd_type)
+	{
+	    case JSON_ARRAY:
+		if (*p == ',')
+		    ++reader->js_used;
+		else if (*p != ']')
+		{
+		    if (*p == NUL)
+			retval = MAYBE;
+		    else
+		    {
+			EMSG(_(e_invarg));
+			retval = FAIL;
+		    }
+		    goto theend;
+		}
+		break;
 
+	    case JSON_OBJECT_KEY:
+		if (*p != ':')
+		{
+		    if (cur_item != NULL && partial == NULL)
+			clear_tv(cur_item);
+		    if (*p == NUL)
+			retval = MAYBE;
+		    else
+		    {
+			EMSG(_(e_invarg));
+			retval = FAIL;
+		    }
+		    goto theend;
+		}
+		++reader->js_used;
 		json_skip_white(reader);
-		p = reader->js_buf + reader->js_used;
+		top_item->jd_type = JSON_OBJECT;
+		if (cur_item != NULL)
+		    cur_item = &item;
+		break;
+
+	    case JSON_OBJECT:
 		if (*p == ',')
 		    ++reader->js_used;
 		else if (*p != '}')
@@ -996,10 +1173,9 @@ item_end:
 		    goto theend;
 		}
 		top_item->jd_type = JSON_OBJECT_KEY;
-		if (cur_item != NULL)
-		    cur_item = &top_item->jd_key_tv;
 		break;
 	}
+	top_item->jd_need_sep = FALSE;
     }
 
     /* Get here when parsing failed. */
@@ -1012,10 +1188,61 @@ item_end:
     EMSG(_(e_invarg));
 
 theend:
-    ga_clear(&stack);
+    if (partial == NULL)
+	ga_clear(stack);
+    else if (retval == FAIL)
+	json_partial_clear(partial);
     return retval;
 }
 
+/*
+ * Free the lists and dicts kept in "partial" and make it empty.
+ */
+    void
+json_partial_clear(json_partial_T *partial)
+{
+    json_dec_item_T *top_item;
+    int		    i;
+
+    /* The first list or dict is also in jp_res. */
+    for (i = 0; i < partial->jp_stack.ga_len; ++i)
+    {
+	top_item = ((json_dec_item_T *)partial->jp_stack.ga_data) + i;
+	if (i > 0)
+	    clear_tv(&top_item->jd_tv);
+	if (top_item->jd_type == (top_item->jd_need_sep
+					     ? JSON_OBJECT_KEY : JSON_OBJECT))
+	    clear_tv(&top_item->jd_key_tv);
+    }
+    ga_clear(&partial->jp_stack);
+    clear_tv(&partial->jp_res);
+    init_tv(&partial->jp_res);
+    partial->jp_used = 0;
+}
+
+/*
+ * Mark the lists and dicts kept in "partial" with "copyID", so that they are
+ * not freed by garbage collection.
+ * Returns TRUE if setting references failed somehow.
+ */
+    int
+set_ref_in_json_partial(
+	json_partial_T	*partial,
+	int		copyID,
+	ht_stack_T	**ht_stack,
+	list_stack_T	**list_stack)
+{
+    int		    abort = FALSE;
+    int		    i;
+
+    abort = set_ref_in_item(&partial->jp_res, copyID, ht_stack, list_stack);
+    for (i = 1; !abort && i < partial->jp_stack.ga_len; ++i)
+	abort = set_ref_in_item(
+		&((json_dec_item_T *)partial->jp_stack.ga_data)[i].jd_tv,
+					       copyID, ht_stack, list_stack);
+    return abort;
+}
+
 /*
  * Decode the JSON from "reader" and store the result in "res".
  * "options" can be JSON_JS or zero;
@@ -1029,7 +1256,7 @@ json_decode_all(js_read_T *reader, typval_T *res, int options)
     /* We find the end once, to avoid calling strlen() many times. */
     reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
     json_skip_white(reader);
-    ret = json_decode_item(reader, res, options);
+    ret = json_decode_item(reader, res, options, NULL);
     if (ret != OK)
     {
 	if (ret == MAYBE)
@@ -1060,12 +1287,56 @@ json_decode(js_read_T *reader, typval_T *res, int options)
     /* We find the end once, to avoid calling strlen() many times. */
     reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
     json_skip_white(reader);
-    ret = json_decode_item(reader, res, options);
+    ret = json_decode_item(reader, res, options, NULL);
     json_skip_white(reader);
 
     return ret;
 }
 
+/*
+ * Decode the JSON from "reader" when it may be only the first part of the
+ * message.  The lists and dicts decoded so far are kept in "partial", which
+ * must be zero when starting a message.  The text before reader->js_used has
+ * been decoded and can be dropped, the next call must continue with the text
+ * that follows.  Only an incomplete number, string or name at the end is
+ * decoded again.
+ * "options" can be JSON_JS or zero.
+ * Return OK when the message is complete, it is moved to "res".
+ * Return MAYBE when the message is incomplete.
+ * Return FAIL for a decoding error, "partial" is cleared.
+ */
+    int
+json_decode_partial(
+	js_read_T	*reader,
+	json_partial_T	*partial,
+	typval_T	*res,
+	int		options)
+{
+    int used_start;
+    int ret;
+
+    reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
+    if (partial->jp_stack.ga_len == 0)
+    {
+	json_skip_white(reader);
+	if (reader->js_buf[reader->js_used] == NUL)
+	    return MAYBE;
+    }
+    used_start = reader->js_used;
+    ret = json_decode_item(reader, NULL, options, partial);
+    if (ret == MAYBE)
+	partial->jp_used += reader->js_used - used_start;
+    else if (ret == OK)
+    {
+	*res = partial->jp_res;
+	init_tv(&partial->jp_res);
+	ga_clear(&partial->jp_stack);
+	partial->jp_used = 0;
+	json_skip_white(reader);
+    }
+    return ret;
+}
+
 /*
  * Decode the JSON from "reader" to find the end of the message.
  * "options" can be JSON_JS or zero.
@@ -1085,7 +1356,7 @@ json_find_end(js_read_T *reader, int options)
     /* We find the end once, to avoid calling strlen() many times. */
     reader->js_end = reader->js_buf + STRLEN(reader->js_buf);
     json_skip_white(reader);
-    ret = json_decode_item(reader, NULL, options);
+    ret = json_decode_item(reader, NULL, options, NULL);
     reader->js_used = used_save;
     return ret;
 }
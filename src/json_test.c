@@ -189,6 +189,186 @@ test_fill_called_on_string(void)
     reader.js_cookie =	      " \"foobar\"  ";
     assert(json_decode_string(&reader, NULL, '"') == OK);
 }
+
+/*
+ * Decode "text" with json_decode_partial(), giving it "step" more bytes each
+ * time, and check the result is the same as decoding it at once.
+ */
+    static void
+check_decode_partial(char *text, int step, int options)
+{
+    json_partial_T  partial;
+    js_read_T	    reader;
+    typval_T	    tv;
+    typval_T	    res;
+    char_u	    *buf;
+    int		    len = (int)STRLEN(text);
+    int		    used = 0;
+    int		    end;
+    int		    ret = MAYBE;
+
+    vim_memset(&partial, 0, sizeof(partial));
+    reader.js_fill = NULL;
+    for (end = step; ret == MAYBE; end += step)
+    {
+	if (end > len)
+	    end = len;
+	buf = vim_strnsave((char_u *)text + used, end - used);
+	reader.js_buf = buf;
+	reader.js_used = 0;
+	ret = json_decode_partial(&reader, &partial, &res, options);
+	used += reader.js_used;
+	vim_free(buf);
+	assert(ret == OK || (ret == MAYBE && end < len));
+    }
+    assert(*skipwhite((char_u *)text + used) == NUL);
+    assert(partial.jp_stack.ga_len == 0);
+
+    reader.js_buf = (char_u *)text;
+    reader.js_used = 0;
+    assert(json_decode_all(&reader, &tv, options) == OK);
+    assert(tv_equal(&tv, &res, FALSE, FALSE));
+    clear_tv(&tv);
+    clear_tv(&res);
+}
+
+/*
+ * Test json_decode_partial() with messages that arrive in pieces.
+ */
+    static void
+test_decode_partial(void)
+{
+    static char *texts[] = {
+	"[1, \"hello\", [2, 3], {\"a\": [4, {\"b\": -56}]}]",
+	"  [ 12345 , -678 , true , false , null , \"\\u00e9t\\u00e9\" ] ",
+#ifdef FEAT_FLOAT
+	"[1.5, -2.25e10, 3E-2, {\"x\": 0.125}]",
+#endif
+	"{\"key\" : {\"nested\" : [[], {}, [[\"deep\"]]]}, \"k2\":\"v\"}",
+	"[0, [\"one\", \"two\", \"three\", \"four\", \"five\"]]",
+    };
+    json_partial_T  partial;
+    js_read_T	    reader;
+    typval_T	    res;
+    int		    i;
+    int		    step;
+
+    for (i = 0; i < (int)(sizeof(texts) / sizeof(char *)); ++i)
+	for (step = 1; step < 8; ++step)
+	    check_decode_partial(texts[i], step, 0);
+    for (step = 1; step < 8; ++step)
+	check_decode_partial("{ a : [1, 'two'], bb: {c:3}, ccc: 'x'}",
+								step, JSON_JS);
+
+    /* a truncated number is decoded again, not split */
+    vim_memset(&partial, 0, sizeof(partial));
+    reader.js_fill = NULL;
+    reader.js_buf = (char_u *)"[1, 23";
+    reader.js_used = 0;
+    assert(json_decode_partial(&reader, &partial, &res, 0) == MAYBE);
+    assert(reader.js_used == 4);
+    reader.js_buf = (char_u *)"23456]";
+    reader.js_used = 0;
+    assert(json_decode_partial(&reader, &partial, &res, 0) == OK);
+    assert(res.v_type == VAR_LIST && res.vval.v_list->lv_len == 2);
+    assert(res.vval.v_list->lv_last->li_tv.vval.v_number == 23456);
+    clear_tv(&res);
+
+    /* an error clears the state */
+    reader.js_buf = (char_u *)"[1, {\"a\": [2";
+    reader.js_used = 0;
+    assert(json_decode_partial(&reader, &partial, &res, 0) == MAYBE);
+    assert(partial.jp_stack.ga_len == 3);
+    reader.js_buf = (char_u *)"2 }";
+    reader.js_used = 0;
+    ++emsg_silent;
+    assert(json_decode_partial(&reader, &partial, &res, 0) == FAIL);
+    --emsg_silent;
+    assert(partial.jp_stack.ga_len == 0);
+    assert(partial.jp_used == 0);
+}
+
+/*
+ * Build a message that looks like what a language server sends: many
+ * objects with file names, positions and messages, some with escapes and
+ * non-ASCII characters.
+ */
+    static char_u *
+make_payload(int count)
+{
+    garray_T	ga;
+    char	buf[600];
+    int		i;
+
+    ga_init2(&ga, 1, 100000);
+    ga_concat(&ga, (char_u *)"[0, {\"jsonrpc\": \"2.0\", \"diagnostics\": [");
+    for (i = 0; i < count; ++i)
+    {
+	vim_snprintf(buf, sizeof(buf),
+		"%s{\"uri\": \"file:///home/user/projects/editor/src/module%d/source_file_%d.c\", "
+		"\"range\": {\"start\": {\"line\": %d, \"character\": 4}, "
+		"\"end\": {\"line\": %d, \"character\": 27}}, \"severity\": %d, "
+		"\"source\": \"compiler\", \"code\": \"unused-variable\", "
+		"\"message\": \"%s\", \"tags\": [1, 2]}",
+		i == 0 ? "" : ", ", i % 37, i, i * 3, i * 3 + 1, i % 4 + 1,
+		i % 10 == 0
+		    ? "unused variable \\\"r\\u00e9sum\\u00e9\\\"\\n\\tdeclared here"
+		    : i % 10 == 1
+			? "variable \xc3\xa9t\xc3\xa9 is set but not used \xe2\x80\x94 remove it"
+			: "unused variable 'result_of_the_computation' in this function, consider removing it");
+	ga_concat(&ga, (char_u *)buf);
+    }
+    ga_concat(&ga, (char_u *)"]}]");
+    ga_append(&ga, NUL);
+    return ga.ga_data;
+}
+
+/*
+ * Decode and encode a message with long strings, escapes and non-ASCII
+ * characters, which exercises both the word-at-a-time scanning and the
+ * character-by-character code.
+ */
+    static void
+test_decode_encode_payload(void)
+{
+    js_read_T	reader;
+    typval_T	tv;
+    typval_T	tv2;
+    char_u	*payload = make_payload(100);
+    char_u	*encoded;
+    dictitem_T	*di;
+    listitem_T	*li;
+
+    reader.js_buf = payload;
+    reader.js_used = 0;
+    reader.js_fill = NULL;
+    assert(json_decode_all(&reader, &tv, 0) == OK);
+
+    /* check the message with escapes in the first item */
+    assert(tv.v_type == VAR_LIST);
+    li = tv.vval.v_list->lv_first->li_next;
+    assert(li->li_tv.v_type == VAR_DICT);
+    di = dict_find(li->li_tv.vval.v_dict, (char_u *)"diagnostics", -1);
+    assert(di != NULL && di->di_tv.v_type == VAR_LIST);
+    li = di->di_tv.vval.v_list->lv_first;
+    di = dict_find(li->li_tv.vval.v_dict, (char_u *)"message", -1);
+    assert(di != NULL && di->di_tv.v_type == VAR_STRING);
+    assert(STRCMP(di->di_tv.vval.v_string,
+	  "unused variable \"r\xc3\xa9sum\xc3\xa9\"\n\tdeclared here") == 0);
+
+    /* decoding the encoded text gives the same value */
+    encoded = json_encode(&tv, 0);
+    assert(encoded != NULL);
+    reader.js_buf = encoded;
+    reader.js_used = 0;
+    assert(json_decode_all(&reader, &tv2, 0) == OK);
+    assert(tv_equal(&tv, &tv2, FALSE, FALSE));
+
+    clear_tv(&tv);
+    clear_tv(&tv2);
+    vim_free(encoded);
+    vim_free(payload);
+}
 #endif
 
     int
@@ -198,6 +378,12 @@ main(void)
     test_decode_find_end();
     test_fill_called_on_find_end();
     test_fill_called_on_string();
+# ifdef FEAT_MBYTE
+    /* strings are converted when 'encoding' is not utf-8 */
+    enc_utf8 = TRUE;
+# endif
+    test_decode_partial();
+    test_decode_encode_payload();
 #endif
     return 0;
 }
@@ -5,6 +5,9 @@
 
 #define strneq(a,b,n) (strncmp(a,b,n)==0)
 
+/* Printable ASCII: always one cell wide and never combining. */
+#define IS_PRINTABLE_ASCII(c) ((c) >= 0x20 && (c) < 0x7f)
+
 #if defined(DEBUG) && DEBUG > 1
 # define DEBUG_GLYPH_COMBINE
 #endif
@@ -322,17 +325,27 @@ static int on_text(const char bytes[], size_t len, void *user)
     int glyph_ends;
     int width = 0;
     uint32_t *chars;
+    /* Most glyphs fit in here, avoids an allocation for each glyph */
+    uint32_t chars_buf[VTERM_MAX_CHARS_PER_CELL + 1];
 
+    /* A run of plain text is mostly printable ASCII, skip the lookups */
     for(glyph_ends = i + 1; glyph_ends < npoints; glyph_ends++)
-      if(!vterm_unicode_is_combining(codepoints[glyph_ends]))
+      if(IS_PRINTABLE_ASCII(codepoints[glyph_ends]) ||
+         !vterm_unicode_is_combining(codepoints[glyph_ends]))
         break;
 
-    chars = vterm_allocator_malloc(state->vt, (glyph_ends - glyph_starts + 1) * sizeof(uint32_t));
+    if(glyph_ends - glyph_starts < VTERM_MAX_CHARS_PER_CELL + 1)
+      chars = chars_buf;
+    else
+      chars = vterm_allocator_malloc(state->vt, (glyph_ends - glyph_starts + 1) * sizeof(uint32_t));
 
     for( ; i < glyph_ends; i++) {
       int this_width;
       chars[i - glyph_starts] = codepoints[i];
-      this_width = vterm_unicode_width(codepoints[i]);
+      if(IS_PRINTABLE_ASCII(codepoints[i]))
+        this_width = 1;
+      else
+        this_width = vterm_unicode_width(codepoints[i]);
 #ifdef DEBUG
       if(this_width < 0) {
         fprintf(stderr, "Text with negative-width codepoint U+%04x\n", codepoints[i]);
@@ -397,7 +410,8 @@ static int on_text(const char bytes[], size_t len, void *user)
     else {
       state->pos.col += width;
     }
-    vterm_allocator_free(state->vt, chars);
+    if(chars != chars_buf)
+      vterm_allocator_free(state->vt, chars);
   }
 
   updatecursor(state, &oldpos, 0);
@@ -18,6 +18,12 @@
 /* List heads for garbage collection. */
 static list_T		*first_list = NULL;	/* list of all lists */
 
+/* Only lists with at least this many items get an index array. */
+#define LIST_INDEX_MIN	50
+
+static int list_index_fill(list_T *l, long n);
+static void list_index_trunc(list_T *l, listitem_T *item);
+
 /*
  * Add a watcher to a list.
  */
@@ -121,8 +127,13 @@ rettv_list_set(typval_T *rettv, list_T *l)
     void
 list_unref(list_T *l)
 {
-    if (l != NULL && --l->lv_refcount <= 0)
-	list_free(l);
+    if (l != NULL)
+    {
+	if (--l->lv_refcount <= 0)
+	    list_free(l);
+	else
+	    may_have_garbage = TRUE;
+    }
 }
 
 /*
@@ -141,18 +152,20 @@ list_free_contents(list_T *l)
 	clear_tv(&item->li_tv);
 	vim_free(item);
     }
+    l->lv_index_len = 0;
 }
 
 /*
  * Go through the list of lists and free items without the copyID.
  * But don't free a list that has a watcher (used in a for loop), these
  * are not referenced anywhere.
+ * Returns the number of lists freed.
  */
     int
 list_free_nonref(int copyID)
 {
     list_T	*ll;
-    int		did_free = FALSE;
+    int		did_free = 0;
 
     for (ll = first_list; ll != NULL; ll = ll->lv_used_next)
 	if ((ll->lv_copyID & COPYID_MASK) != (copyID & COPYID_MASK)
@@ -162,7 +175,7 @@ list_free_nonref(int copyID)
 	     * into Lists and Dictionaries, they will be in the list of dicts
 	     * or list of lists. */
 	    list_free_contents(ll);
-	    did_free = TRUE;
+	    ++did_free;
 	}
     return did_free;
 }
@@ -178,6 +191,7 @@ list_free_list(list_T  *l)
     if (l->lv_used_next != NULL)
 	l->lv_used_next->lv_used_prev = l->lv_used_prev;
 
+    vim_free(l->lv_index);
     vim_free(l);
 }
 
@@ -300,8 +314,18 @@ list_find(list_T *l, long n)
     if (n < 0 || n >= l->lv_len)
 	return NULL;
 
+    /* Use the index array when it has the item or when it can be extended
+     * to "n" with fewer steps than going back from the end. */
+    if (n < l->lv_index_len
+	    || (l->lv_len >= LIST_INDEX_MIN
+		&& n - l->lv_index_len < l->lv_len - n
+		&& list_index_fill(l, n) == OK))
+    {
+	item = l->lv_index[n];
+	idx = n;
+    }
     /* When there is a cached index may start search from there. */
-    if (l->lv_idx_item != NULL)
+    else if (l->lv_idx_item != NULL)
     {
 	if (n < l->lv_idx / 2)
 	{
@@ -358,6 +382,65 @@ list_find(list_T *l, long n)
     return item;
 }
 
+/*
+ * Extend the index array of list "l" to include the item at index "n".
+ * Returns FAIL when out of memory.
+ */
+    static int
+list_index_fill(list_T *l, long n)
+{
+    listitem_T	*item;
+
+    if (n >= l->lv_index_size)
+    {
+	int	    size = l->lv_len + l->lv_len / 2;
+	listitem_T  **index;
+
+	index = (listitem_T **)vim_realloc(l->lv_index,
+					       sizeof(listitem_T *) * size);
+	if (index == NULL)
+	    return FAIL;
+	l->lv_index = index;
+	l->lv_index_size = size;
+    }
+
+    if (l->lv_index_len == 0)
+	item = l->lv_first;
+    else
+	item = l->lv_index[l->lv_index_len - 1]->li_next;
+    while (l->lv_index_len <= n)
+    {
+	l->lv_index[l->lv_index_len++] = item;
+	item = item->li_next;
+    }
+    return OK;
+}
+
+/*
+ * Called before the list "l" is changed at "item": the index array remains
+ * valid only for the items before "item".
+ */
+    static void
+list_index_trunc(list_T *l, listitem_T *item)
+{
+    if (l->lv_index_len == 0)
+	return;
+    if (item == l->lv_idx_item)
+    {
+	/* The cached index tells where "item" is. */
+	if (l->lv_idx < l->lv_index_len)
+	    l->lv_index_len = l->lv_idx;
+    }
+    else if (item->li_next == NULL)
+    {
+	/* Changing the last item. */
+	if (l->lv_len - 1 < l->lv_index_len)
+	    l->lv_index_len = l->lv_len - 1;
+    }
+    else
+	l->lv_index_len = 0;
+}
+
 /*
  * Get list item "l[idx]" as a number.
  */
@@ -563,6 +646,7 @@ list_insert(list_T *l, listitem_T *ni, listitem_T *item)
     else
     {
 	/* Insert new item before existing item. */
+	list_index_trunc(l, item);
 	ni->li_prev = item->li_prev;
 	ni->li_next = item;
 	if (item->li_prev == NULL)
@@ -688,6 +772,8 @@ vimlist_remove(list_T *l, listitem_T *item, listitem_T *item2)
 {
     listitem_T	*ip;
 
+    list_index_trunc(l, item);
+
     /* notify watchers */
     for (ip = item; ip != NULL; ip = ip->li_next)
     {
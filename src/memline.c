@@ -2498,7 +2498,12 @@ errorret:
 	buf->b_ml.ml_flags &= ~ML_LINE_DIRTY;
     }
     if (will_change)
+    {
 	buf->b_ml.ml_flags |= (ML_LOCKED_DIRTY | ML_LOCKED_POS);
+#ifdef FEAT_SEARCH_EXTRA
+	hls_cache_changed(buf, lnum, 0);
+#endif
+    }
 
     return buf->b_ml.ml_line_ptr;
 }
@@ -3049,6 +3054,9 @@ ml_append_int(
     /* The line was inserted below 'lnum' */
     ml_updatechunk(buf, lnum + 1, (long)len, ML_CHNK_ADDLINE);
 #endif
+#ifdef FEAT_SEARCH_EXTRA
+    hls_cache_changed(buf, lnum + 1, 1);
+#endif
 #ifdef FEAT_NETBEANS_INTG
     if (netbeans_active())
     {
@@ -3089,6 +3097,9 @@ ml_replace(linenr_T lnum, char_u *line, int copy)
 
     if (copy && (line = vim_strsave(line)) == NULL) /* allocate memory */
 	return FAIL;
+#ifdef FEAT_SEARCH_EXTRA
+    hls_cache_changed(curbuf, lnum, 0);
+#endif
 #ifdef FEAT_NETBEANS_INTG
     if (netbeans_active())
     {
@@ -3194,6 +3205,9 @@ ml_delete_int(buf_T *buf, linenr_T lnum, int message)
     if (netbeans_active())
 	netbeans_removed(buf, lnum, 0, (long)line_size);
 #endif
+#ifdef FEAT_SEARCH_EXTRA
+    hls_cache_changed(buf, lnum, -1);
+#endif
 
 /*
  * special case: If there is only one line in the data block it becomes empty.
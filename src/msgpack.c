@@ -0,0 +1,558 @@
+/* vi:set ts=8 sts=4 sw=4 noet:
+ *
+ * VIM - Vi IMproved	by Bram Moolenaar
+ *
+ * Do ":help uganda"  in Vim to read copying and usage conditions.
+ * Do ":help credits" in Vim to see a list of people who contributed.
+ * See README.txt for an overview of the Vim source code.
+ */
+
+/*
+ * msgpack.c: Encoding and decoding MessagePack for a channel in "msgpack"
+ * mode.
+ *
+ * Follows this specification: https://github.com/msgpack/msgpack/blob/master/spec.md
+ * A message is a four byte length in network byte order, followed by that
+ * many bytes with the encoding of one value.  Thus the end of a message is
+ * found without looking at its contents.
+ */
+#define USING_FLOAT_STUFF
+
+#include "vim.h"
+
+#if defined(FEAT_JOB_CHANNEL) || defined(PROTO)
+
+/* Lists and dicts nested deeper than this are not decoded, to avoid running
+ * out of stack space. */
+#define MSGPACK_MAX_DEPTH 1000
+
+static int msgpack_encode_item(garray_T *gap, typval_T *val, int copyID);
+static int msgpack_decode_item(char_u **pp, char_u *end, typval_T *res, int depth);
+
+/*
+ * Append "len" bytes of "n" to "gap", most significant byte first.
+ */
+    static void
+put_be(garray_T *gap, uvarnumber_T n, int len)
+{
+    char_u  *p;
+    int	    i;
+
+    if (ga_grow(gap, len) == FAIL)
+	return;
+    p = (char_u *)gap->ga_data + gap->ga_len;
+    for (i = len - 1; i >= 0; --i)
+    {
+	p[i] = (char_u)(n & 0xff);
+	n >>= 8;
+    }
+    gap->ga_len += len;
+}
+
+/*
+ * Append type byte "c" followed by "len" bytes of "n" to "gap".
+ */
+    static void
+put_typed(garray_T *gap, int c, uvarnumber_T n, int len)
+{
+    ga_append(gap, c);
+    put_be(gap, n, len);
+}
+
+/*
+ * Append the header for a string, array or map of "len" items.  "fix" is
+ * the type byte of the short form, which is used when "len" is below
+ * "fixmax".  "c8" is the type byte for an 8 bit length, zero if there is
+ * none.  "c16" is the type byte for a 16 bit length, plus one for a 32 bit
+ * length.
+ */
+    static void
+put_header(garray_T *gap, long_u len, int fix, int fixmax, int c8, int c16)
+{
+    if (len < (long_u)fixmax)
+	ga_append(gap, fix | (int)len);
+    else if (c8 != 0 && len < 0x100)
+	put_typed(gap, c8, (uvarnumber_T)len, 1);
+    else if (len < 0x10000)
+	put_typed(gap, c16, (uvarnumber_T)len, 2);
+    else
+	put_typed(gap, c16 + 1, (uvarnumber_T)len, 4);
+}
+
+    static void
+put_number(garray_T *gap, varnumber_T n)
+{
+    uvarnumber_T    u = (uvarnumber_T)n;
+
+    if (n >= 0)
+    {
+	if (n < 0x80)
+	    ga_append(gap, (int)n);
+	else if (n < 0x100)
+	    put_typed(gap, 0xcc, u, 1);
+	else if (n < 0x10000)
+	    put_typed(gap, 0xcd, u, 2);
+	else if (u <= (uvarnumber_T)0xffffffffUL)
+	    put_typed(gap, 0xce, u, 4);
+	else
+	    put_typed(gap, 0xcf, u, 8);
+    }
+    else
+    {
+	if (n >= -32)
+	    ga_append(gap, (int)(u & 0xff));
+	else if (n >= -0x80)
+	    put_typed(gap, 0xd0, u, 1);
+	else if (n >= -0x8000)
+	    put_typed(gap, 0xd1, u, 2);
+	else if (n >= -0x7fffffffL - 1)
+	    put_typed(gap, 0xd2, u, 4);
+	else
+	    put_typed(gap, 0xd3, u, 8);
+    }
+}
+
+#ifdef FEAT_FLOAT
+    static void
+put_float(garray_T *gap, float_T f)
+{
+    double	d = (double)f;
+    char_u	b[8];
+    int		i;
+
+    if (ga_grow(gap, 9) == FAIL)
+	return;
+    mch_memmove(b, &d, 8);
+    ga_append(gap, 0xcb);
+    for (i = 0; i < 8; ++i)
+# ifdef WORDS_BIGENDIAN
+	ga_append(gap, b[i]);
+# else
+	ga_append(gap, b[7 - i]);
+# endif
+}
+#endif
+
+/*
+ * Append string "str" to "gap".  It is converted to utf-8 when needed.
+ */
+    static void
+put_string(garray_T *gap, char_u *str)
+{
+    char_u	*res = str == NULL ? (char_u *)"" : str;
+    long_u	len;
+#if defined(FEAT_MBYTE) && defined(USE_ICONV)
+    vimconv_T   conv;
+    char_u	*converted = NULL;
+
+    if (!enc_utf8)
+    {
+	/* The string is always utf-8, ignore 'encoding'. */
+	conv.vc_type = CONV_NONE;
+	convert_setup(&conv, p_enc, (char_u*)"utf-8");
+	if (conv.vc_type != CONV_NONE)
+	    converted = res = string_convert(&conv, res, NULL);
+	convert_setup(&conv, NULL, NULL);
+	if (res == NULL)
+	    res = str;
+    }
+#endif
+    len = (long_u)STRLEN(res);
+    put_header(gap, len, 0xa0, 32, 0xd9, 0xda);
+    if (ga_grow(gap, (int)len) == OK)
+    {
+	mch_memmove((char *)gap->ga_data + gap->ga_len, res, (size_t)len);
+	gap->ga_len += (int)len;
+    }
+#if defined(FEAT_MBYTE) && defined(USE_ICONV)
+    vim_free(converted);
+#endif
+}
+
+/*
+ * Encode "val" into "gap".
+ * Return FAIL or OK.
+ */
+    static int
+msgpack_encode_item(garray_T *gap, typval_T *val, int copyID)
+{
+    list_T	*l;
+    dict_T	*d;
+
+    switch (val->v_type)
+    {
+	case VAR_SPECIAL:
+	    switch (val->vval.v_number)
+	    {
+		case VVAL_FALSE: ga_append(gap, 0xc2); break;
+		case VVAL_TRUE: ga_append(gap, 0xc3); break;
+		case VVAL_NONE:
+		case VVAL_NULL: ga_append(gap, 0xc0); break;
+	    }
+	    break;
+
+	case VAR_NUMBER:
+	    put_number(gap, val->vval.v_number);
+	    break;
+
+	case VAR_STRING:
+	    put_string(gap, val->vval.v_string);
+	    break;
+
+	case VAR_FUNC:
+	case VAR_PARTIAL:
+	case VAR_JOB:
+	case VAR_CHANNEL:
+	    /* no MessagePack equivalent */
+	    EMSG(_(e_invarg));
+	    return FAIL;
+
+	case VAR_LIST:
+	    l = val->vval.v_list;
+	    if (l == NULL || l->lv_copyID == copyID)
+		/* a recursive list is encoded as an empty list */
+		ga_append(gap, 0x90);
+	    else
+	    {
+		listitem_T	*li;
+
+		l->lv_copyID = copyID;
+		put_header(gap, (long_u)l->lv_len, 0x90, 16, 0, 0xdc);
+		for (li = l->lv_first; li != NULL && !got_int;
+							      li = li->li_next)
+		    if (msgpack_encode_item(gap, &li->li_tv, copyID) == FAIL)
+			return FAIL;
+		l->lv_copyID = 0;
+	    }
+	    break;
+
+	case VAR_DICT:
+	    d = val->vval.v_dict;
+	    if (d == NULL || d->dv_copyID == copyID)
+		ga_append(gap, 0x80);
+	    else
+	    {
+		int		todo = (int)d->dv_hashtab.ht_used;
+		hashitem_T	*hi;
+
+		d->dv_copyID = copyID;
+		put_header(gap, (long_u)todo, 0x80, 16, 0, 0xde);
+		for (hi = d->dv_hashtab.ht_array; todo > 0 && !got_int; ++hi)
+		    if (!HASHITEM_EMPTY(hi))
+		    {
+			--todo;
+			put_string(gap, hi->hi_key);
+			if (msgpack_encode_item(gap, &dict_lookup(hi)->di_tv,
+							     copyID) == FAIL)
+			    return FAIL;
+		    }
+		d->dv_copyID = 0;
+	    }
+	    break;
+
+	case VAR_FLOAT:
+#ifdef FEAT_FLOAT
+	    put_float(gap, val->vval.v_float);
+	    break;
+#endif
+	case VAR_UNKNOWN:
+	    internal_error("msgpack_encode_item()");
+	    return FAIL;
+    }
+    return OK;
+}
+
+/*
+ * Encode ["nr", "val"] into a message: the four byte length followed by the
+ * MessagePack encoding.  The result is in allocated memory and "*lenp" is
+ * set to its length.
+ * Returns NULL when out of memory or "val" cannot be encoded.
+ */
+    char_u *
+msgpack_encode_nr_expr(int nr, typval_T *val, int *lenp)
+{
+    garray_T	ga;
+
+    ga_init2(&ga, 1, 4000);
+    /* the length is filled in below */
+    put_be(&ga, (uvarnumber_T)0, 4);
+    ga_append(&ga, 0x92);
+    put_number(&ga, (varnumber_T)nr);
+    if (msgpack_encode_item(&ga, val, get_copyID()) == FAIL)
+    {
+	ga_clear(&ga);
+	return NULL;
+    }
+    *lenp = ga.ga_len;
+    ga.ga_len = 0;
+    put_be(&ga, (uvarnumber_T)(*lenp - 4), 4);
+    return ga.ga_data;
+}
+
+/*
+ * Return the length of the message of which the four byte length starts at
+ * "p".
+ */
+    long_u
+msgpack_msg_len(char_u *p)
+{
+    return ((long_u)p[0] << 24) + ((long_u)p[1] << 16)
+					     + ((long_u)p[2] << 8) + p[3];
+}
+
+/*
+ * Get "len" bytes at "*pp" as an unsigned number, most significant byte
+ * first.  Advances "*pp".
+ */
+    static uvarnumber_T
+get_be(char_u **pp, int len)
+{
+    uvarnumber_T    n = 0;
+    int		    i;
+
+    for (i = 0; i < len; ++i)
+	n = (n << 8) + *(*pp)++;
+    return n;
+}
+
+/*
+ * Decode a string of "len" bytes at "*pp" into "res".  It is converted from
+ * utf-8 to 'encoding' when needed.
+ */
+    static int
+decode_string(char_u **pp, long_u len, typval_T *res)
+{
+    char_u	*s;
+
+    s = vim_strnsave(*pp, (int)len);
+    if (s == NULL)
+	return FAIL;
+    *pp += len;
+#if defined(FEAT_MBYTE) && defined(USE_ICONV)
+    if (!enc_utf8)
+    {
+	vimconv_T   conv;
+	char_u	    *converted;
+
+	conv.vc_type = CONV_NONE;
+	convert_setup(&conv, (char_u*)"utf-8", p_enc);
+	if (conv.vc_type != CONV_NONE)
+	{
+	    converted = string_convert(&conv, s, NULL);
+	    if (converted != NULL)
+	    {
+		vim_free(s);
+		s = converted;
+	    }
+	}
+	convert_setup(&conv, NULL, NULL);
+    }
+#endif
+    res->v_type = VAR_STRING;
+    res->vval.v_string = s;
+    return OK;
+}
+
+/*
+ * Decode a list of "count" items at "*pp" into "res".
+ */
+    static int
+decode_list(char_u **pp, char_u *end, long_u count, typval_T *res, int depth)
+{
+    typval_T	item;
+
+    /* Each item takes at least one byte. */
+    if (count > (long_u)(end - *pp) || rettv_list_alloc(res) == FAIL)
+	return FAIL;
+    while (count-- > 0)
+    {
+	if (msgpack_decode_item(pp, end, &item, depth + 1) == FAIL)
+	    return FAIL;
+	if (list_append_tv(res->vval.v_list, &item) == FAIL)
+	{
+	    clear_tv(&item);
+	    return FAIL;
+	}
+	clear_tv(&item);
+    }
+    return OK;
+}
+
+/*
+ * Decode a dict of "count" key-value pairs at "*pp" into "res".  A key must
+ * be a string or a number.
+ */
+    static int
+decode_dict(char_u **pp, char_u *end, long_u count, typval_T *res, int depth)
+{
+    typval_T	key_tv;
+    char_u	*key;
+    char_u	key_buf[NUMBUFLEN];
+    dictitem_T	*di;
+
+    /* Each pair takes at least two bytes. */
+    if (count > (long_u)(end - *pp) / 2 || rettv_dict_alloc(res) == FAIL)
+	return FAIL;
+    while (count-- > 0)
+    {
+	if (msgpack_decode_item(pp, end, &key_tv, depth + 1) == FAIL)
+	    return FAIL;
+	key = NULL;
+	if (key_tv.v_type == VAR_STRING || key_tv.v_type == VAR_NUMBER)
+	    key = get_tv_string_buf_chk(&key_tv, key_buf);
+	if (key == NULL || dict_find(res->vval.v_dict, key, -1) != NULL
+		|| (di = dictitem_alloc(key)) == NULL)
+	{
+	    clear_tv(&key_tv);
+	    return FAIL;
+	}
+	clear_tv(&key_tv);
+	if (msgpack_decode_item(pp, end, &di->di_tv, depth + 1) == FAIL)
+	{
+	    dictitem_free(di);
+	    return FAIL;
+	}
+	if (dict_add(res->vval.v_dict, di) == FAIL)
+	{
+	    dictitem_free(di);
+	    return FAIL;
+	}
+    }
+    return OK;
+}
+
+/*
+ * Decode one item at "*pp" into "res" and advance "*pp".  "end" is where the
+ * message ends.
+ * Returns FAIL when the item is invalid or does not fit, "res" is then
+ * cleared.
+ */
+    static int
+msgpack_decode_item(char_u **pp, char_u *end, typval_T *res, int depth)
+{
+    int		    c;
+    int		    len = 0;
+    long_u	    count;
+    uvarnumber_T    u;
+    int		    ret = OK;
+
+    init_tv(res);
+    if (*pp >= end || depth > MSGPACK_MAX_DEPTH)
+	return FAIL;
+    c = *(*pp)++;
+
+    /* Number of bytes that follow the type byte for a length or value. */
+    if ((c >= 0xc4 && c <= 0xc6) || (c >= 0xd9 && c <= 0xdb))
+	len = c == 0xc4 || c == 0xd9 ? 1 : c == 0xc5 || c == 0xda ? 2 : 4;
+    else if ((c >= 0xcc && c <= 0xd3) || c == 0xca || c == 0xcb)
+	len = c == 0xca ? 4 : c == 0xcb ? 8 : 1 << (c & 3);
+    else if (c >= 0xdc && c <= 0xdf)
+	len = c & 1 ? 4 : 2;
+    if (end - *pp < len)
+	return FAIL;
+
+    if (c < 0x80 || c >= 0xe0)
+    {
+	/* positive or negative fixint */
+	res->v_type = VAR_NUMBER;
+	res->vval.v_number = c < 0x80 ? c : c - 0x100;
+    }
+    else if (c < 0x90)
+	ret = decode_dict(pp, end, (long_u)(c & 0x0f), res, depth);
+    else if (c < 0xa0)
+	ret = decode_list(pp, end, (long_u)(c & 0x0f), res, depth);
+    else if (c < 0xc0 || (c >= 0xc4 && c <= 0xc6) || (c >= 0xd9 && c <= 0xdb))
+    {
+	/* str or bin, a bin is used as a string */
+	count = c < 0xc0 ? (long_u)(c & 0x1f) : (long_u)get_be(pp, len);
+	if (count > (long_u)(end - *pp))
+	    return FAIL;
+	ret = decode_string(pp, count, res);
+    }
+    else if (c == 0xc0 || c == 0xc2 || c == 0xc3)
+    {
+	res->v_type = VAR_SPECIAL;
+	res->vval.v_number = c == 0xc0 ? VVAL_NULL
+				     : c == 0xc2 ? VVAL_FALSE : VVAL_TRUE;
+    }
+    else if (c >= 0xcc && c <= 0xd3)
+    {
+	/* unsigned or signed integer */
+	u = get_be(pp, len);
+	if (c >= 0xd0 && len < (int)sizeof(uvarnumber_T)
+				&& (u & ((uvarnumber_T)1 << (len * 8 - 1))))
+	    /* negative: extend the sign */
+	    u |= ~(uvarnumber_T)0 << (len * 8);
+	res->v_type = VAR_NUMBER;
+	res->vval.v_number = (varnumber_T)u;
+    }
+#ifdef FEAT_FLOAT
+    else if (c == 0xca)
+    {
+	char_u	b[4];
+	float	f;
+	int	i;
+
+	for (i = 0; i < 4; ++i)
+# ifdef WORDS_BIGENDIAN
+	    b[i] = *(*pp)++;
+# else
+	    b[3 - i] = *(*pp)++;
+# endif
+	mch_memmove(&f, b, 4);
+	res->v_type = VAR_FLOAT;
+	res->vval.v_float = f;
+    }
+    else if (c == 0xcb)
+    {
+	char_u	b[8];
+	double	d;
+	int	i;
+
+	for (i = 0; i < 8; ++i)
+# ifdef WORDS_BIGENDIAN
+	    b[i] = *(*pp)++;
+# else
+	    b[7 - i] = *(*pp)++;
+# endif
+	mch_memmove(&d, b, 8);
+	res->v_type = VAR_FLOAT;
+	res->vval.v_float = d;
+    }
+#endif
+    else if (c >= 0xdc && c <= 0xdd)
+	ret = decode_list(pp, end, (long_u)get_be(pp, len), res, depth);
+    else if (c >= 0xde && c <= 0xdf)
+	ret = decode_dict(pp, end, (long_u)get_be(pp, len), res, depth);
+    else
+	/* 0xc1 is never used, extension types are not supported */
+	ret = FAIL;
+
+    if (ret == FAIL)
+    {
+	clear_tv(res);
+	init_tv(res);
+    }
+    return ret;
+}
+
+/*
+ * Decode the value in the "len" bytes at "buf" into "res".
+ * Return FAIL when it is not exactly one valid value.
+ */
+    int
+msgpack_decode(char_u *buf, long_u len, typval_T *res)
+{
+    char_u	*p = buf;
+
+    if (msgpack_decode_item(&p, buf + len, res, 0) == FAIL)
+	return FAIL;
+    if (p != buf + len)
+    {
+	clear_tv(res);
+	init_tv(res);
+	return FAIL;
+    }
+    return OK;
+}
+#endif
@@ -378,7 +378,6 @@ netbeans_parse_messages(void)
     readq_T	*node;
     char_u	*buffer;
     char_u	*p;
-    int		own_node;
 
     while (nb_channel != NULL)
     {
@@ -386,45 +385,26 @@ netbeans_parse_messages(void)
 	if (node == NULL)
 	    break;	/* nothing to read */
 
-	/* Locate the end of the first line in the first buffer. */
+	/* Locate the end of the first line. */
 	p = channel_first_nl(node);
 	if (p == NULL)
-	{
-	    /* Command isn't complete.  If there is no following buffer,
-	     * return (wait for more). If there is another buffer following,
-	     * prepend the text to that buffer and delete this one.  */
-	    if (channel_collapse(nb_channel, PART_SOCK, TRUE) == FAIL)
-		return;
-	    continue;
-	}
+	    /* Command isn't complete, wait for more. */
+	    return;
 
-	/* There is a complete command at the start of the buffer.
-	 * Terminate it with a NUL.  When no more text is following unlink
-	 * the buffer.  Do this before executing, because new buffers can
-	 * be added while busy handling the command. */
-	*p++ = NUL;
-	if (*p == NUL)
-	{
-	    own_node = TRUE;
-	    buffer = channel_get(nb_channel, PART_SOCK);
-	    /* "node" is now invalid! */
-	}
-	else
-	{
-	    own_node = FALSE;
-	    buffer = node->rq_buffer;
-	}
+	/* There is a complete command at the start of the buffer.  Copy it
+	 * and remove it from the buffer before executing, because more text
+	 * can be read while busy handling the command, which may move the
+	 * text. */
+	buffer = vim_strnsave(node->rq_buffer, (int)(p - node->rq_buffer));
+	channel_consume(nb_channel, PART_SOCK,
+					   (int)(p - node->rq_buffer) + 1);
+	if (buffer == NULL)
+	    return;	/* out of memory */
 
 	/* Now, parse and execute the commands.  This may set nb_channel to
 	 * NULL if the channel is closed. */
 	nb_parse_cmd(buffer);
-
-	if (own_node)
-	    /* buffer finished, dispose of it */
-	    vim_free(buffer);
-	else if (nb_channel != NULL)
-	    /* more follows, move it to the start */
-	    channel_consume(nb_channel, PART_SOCK, (int)(p - buffer));
+	vim_free(buffer);
     }
 }
 
@@ -207,6 +207,10 @@ static RETSIGTYPE sig_alarm SIGPROTOARG;
 static volatile int sig_alarm_called;
 #endif
 static RETSIGTYPE deathtrap SIGPROTOARG;
+#ifdef HAVE_PROF_SAMPLE
+static RETSIGTYPE sig_prof_sample SIGPROTOARG;
+static int prof_sample_timer_on = FALSE;
+#endif
 
 static void catch_int_signal(void);
 static void set_signals(void);
@@ -993,6 +997,18 @@ catch_sigpwr SIGDEFARG(sigarg)
 }
 #endif
 
+#ifdef HAVE_PROF_SAMPLE
+/*
+ * Signal function for the ":profile sample" timer.
+ */
+    static RETSIGTYPE
+sig_prof_sample SIGDEFARG(sigarg)
+{
+    prof_sample_record();
+    SIGRETURN;
+}
+#endif
+
 #ifdef SET_SIG_ALARM
 /*
  * signal function for alarm().
@@ -1483,6 +1499,12 @@ catch_signals(
     int	    i;
 
     for (i = 0; signal_info[i].sig != -1; i++)
+    {
+#ifdef HAVE_PROF_SAMPLE
+	/* Don't let the ":profile sample" timer kill Vim. */
+	if (signal_info[i].sig == SIGPROF && prof_sample_timer_on)
+	    continue;
+#endif
 	if (signal_info[i].deadly)
 	{
 #if defined(HAVE_SIGALTSTACK) && defined(HAVE_SIGACTION)
@@ -1518,6 +1540,7 @@ catch_signals(
 	}
 	else if (func_other != SIG_ERR)
 	    signal(signal_info[i].sig, func_other);
+    }
 }
 
 #ifdef HAVE_SIGPROCMASK
@@ -1587,6 +1610,46 @@ vim_handle_signal(int sig)
     return FALSE;
 }
 
+#if defined(HAVE_PROF_SAMPLE) || defined(PROTO)
+/*
+ * Start the timer for ":profile sample", sending SIGPROF every "msec"
+ * milliseconds of CPU time used by Vim.  When "msec" is zero stop the timer
+ * and make SIGPROF a deadly signal again.
+ * Returns FAIL when the timer can't be set.
+ */
+    int
+mch_prof_sample_timer(long msec)
+{
+    struct itimerval	it;
+    int			retval = OK;
+
+    if (msec > 0)
+    {
+# ifdef HAVE_SIGACTION
+	struct sigaction sa;
+
+	/* Restart interrupted system calls, the sample doesn't change what
+	 * they should do. */
+	sa.sa_handler = sig_prof_sample;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGPROF, &sa, NULL);
+# else
+	signal(SIGPROF, (RETSIGTYPE (*)())sig_prof_sample);
+# endif
+    }
+    it.it_interval.tv_sec = msec / 1000;
+    it.it_interval.tv_usec = (msec % 1000) * 1000;
+    it.it_value = it.it_interval;
+    if (setitimer(ITIMER_PROF, &it, NULL) != 0)
+	retval = FAIL;
+    prof_sample_timer_on = msec > 0 && retval == OK;
+    if (!prof_sample_timer_on)
+	signal(SIGPROF, (RETSIGTYPE (*)())deathtrap);
+    return retval;
+}
+#endif
+
 /*
  * Check_win checks whether we have an interactive stdout.
  */
@@ -137,6 +137,13 @@
 
 #include <signal.h>
 
+/* ":profile sample" uses the profiling interval timer, unless something else
+ * already uses SIGPROF (see signal_info[] in os_unix.c). */
+#if defined(FEAT_PROFILE) && defined(SIGPROF) && defined(ITIMER_PROF) \
+	&& !defined(FEAT_MZSCHEME) && !defined(WE_ARE_PROFILING)
+# define HAVE_PROF_SAMPLE
+#endif
+
 #if defined(DIRSIZ) && !defined(MAXNAMLEN)
 # define MAXNAMLEN DIRSIZ
 #endif
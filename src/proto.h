@@ -220,6 +220,7 @@ void qsort(void *base, size_t elm_count, size_t elm_size, int (*cmp)(const void
 # endif
 # ifdef FEAT_JOB_CHANNEL
 #  include "channel.pro"
+#  include "msgpack.pro"
 
 /* Not generated automatically, to add extra attribute. */
 void ch_log(channel_T *ch, const char *fmt, ...)
@@ -20,7 +20,6 @@ readq_T *channel_peek(channel_T *channel, ch_part_T part);
 char_u *channel_first_nl(readq_T *node);
 char_u *channel_get(channel_T *channel, ch_part_T part);
 void channel_consume(channel_T *channel, ch_part_T part, int len);
-int channel_collapse(channel_T *channel, ch_part_T part, int want_nl);
 int channel_can_write_to(channel_T *channel);
 int channel_is_open(channel_T *channel);
 int channel_has_readahead(channel_T *channel, ch_part_T part);
@@ -28,6 +27,7 @@ char *channel_status(channel_T *channel, int req_part);
 void channel_info(channel_T *channel, dict_T *dict);
 void channel_close(channel_T *channel, int invoke_close_cb);
 void channel_close_in(channel_T *channel);
+int channel_writable(channel_T *channel);
 void channel_clear(channel_T *channel);
 void channel_free_all(void);
 void common_channel_read(typval_T *argvars, typval_T *rettv, int raw);
@@ -65,6 +65,7 @@ job_T *job_alloc(void);
 void job_set_options(job_T *job, jobopt_T *opt);
 void job_stop_on_exit(void);
 int has_pending_job(void);
+int has_channel_or_job(void);
 void job_check_ended(void);
 job_T *job_start(typval_T *argvars, char **argv_arg, jobopt_T *opt_arg);
 char *job_status(job_T *job);
@@ -45,6 +45,8 @@ void partial_unref(partial_T *pt);
 int tv_equal(typval_T *tv1, typval_T *tv2, int ic, int recursive);
 int get_copyID(void);
 int garbage_collect(int testing);
+void garbage_collect_when_idle(void);
+void get_garbage_collect_info(dict_T *dict);
 int set_ref_in_ht(hashtab_T *ht, int copyID, list_stack_T **list_stack);
 int set_ref_in_list(list_T *l, int copyID, ht_stack_T **ht_stack);
 int set_ref_in_item(typval_T *tv, int copyID, ht_stack_T **ht_stack, list_stack_T **list_stack);
@@ -136,5 +138,6 @@ char_u *typval_tostring(typval_T *arg);
 int var_exists(char_u *var);
 int modify_fname(char_u *src, int *usedlen, char_u **fnamep, char_u **bufp, int *fnamelen);
 char_u *do_string_sub(char_u *str, char_u *pat, char_u *sub, typval_T *expr, char_u *flags);
+int do_list_sub(list_T *l, char_u *pat, char_u *sub, typval_T *expr, char_u *flags, list_T *result);
 void filter_map(typval_T *argvars, typval_T *rettv, int map);
 /* vim: set ft=c : */
@@ -39,6 +39,9 @@ void ex_profile(exarg_T *eap);
 char_u *get_profile_name(expand_T *xp, int idx);
 void set_context_in_profile_cmd(expand_T *xp, char_u *arg);
 void profile_dump(void);
+void prof_sample_set_pos(void);
+void prof_sample_record(void);
+void prof_sample_fold(void);
 void script_prof_save(proftime_T *tm);
 void script_prof_restore(proftime_T *tm);
 void prof_inchar_enter(void);
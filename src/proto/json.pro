@@ -1,7 +1,10 @@
 /* json.c */
 char_u *json_encode(typval_T *val, int options);
 char_u *json_encode_nr_expr(int nr, typval_T *val, int options);
+void json_partial_clear(json_partial_T *partial);
+int set_ref_in_json_partial(json_partial_T *partial, int copyID, ht_stack_T **ht_stack, list_stack_T **list_stack);
 int json_decode_all(js_read_T *reader, typval_T *res, int options);
 int json_decode(js_read_T *reader, typval_T *res, int options);
+int json_decode_partial(js_read_T *reader, json_partial_T *partial, typval_T *res, int options);
 int json_find_end(js_read_T *reader, int options);
 /* vim: set ft=c : */
@@ -0,0 +1,5 @@
+/* msgpack.c */
+char_u *msgpack_encode_nr_expr(int nr, typval_T *val, int *lenp);
+long_u msgpack_msg_len(char_u *p);
+int msgpack_decode(char_u *buf, long_u len, typval_T *res);
+/* vim: set ft=c : */
@@ -14,6 +14,7 @@ void mch_suspend(void);
 void mch_init(void);
 void reset_signals(void);
 int vim_handle_signal(int sig);
+int mch_prof_sample_timer(long msec);
 int mch_check_win(int argc, char **argv);
 int mch_input_isatty(void);
 int mch_can_restore_title(void);
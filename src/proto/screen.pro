@@ -31,6 +31,8 @@ void screen_putchar(int c, int row, int col, int attr);
 void screen_getbytes(int row, int col, char_u *bytes, int *attrp);
 void screen_puts(char_u *text, int row, int col, int attr);
 void screen_puts_len(char_u *text, int textlen, int row, int col, int attr);
+void hls_cache_free(buf_T *buf);
+void hls_cache_changed(buf_T *buf, linenr_T lnum, int xtra);
 void screen_stop_highlight(void);
 void reset_cterm_colors(void);
 void screen_draw_rectangle(int row, int col, int height, int width, int invert);
@@ -19,6 +19,7 @@ void set_last_csearch(int c, char_u *s, int len);
 void set_csearch_direction(int cdir);
 void set_csearch_until(int t_cmd);
 char_u *last_search_pat(void);
+int last_search_pat_magic(void);
 void reset_search_dir(void);
 void set_last_search_pat(char_u *s, int idx, int magic, int setlast);
 void last_pat_prog(regmmatch_T *regmatch);
@@ -44,6 +45,7 @@ int current_tagblock(oparg_T *oap, long count_arg, int include);
 int current_par(oparg_T *oap, long count, int include, int type);
 int current_quote(oparg_T *oap, long count, int include, int quotechar);
 int current_search(long count, int forward);
+int search_count(char_u *pat, pos_T *pos, int recompute, long time_limit, long maxcount, long *current, long *total, int *exact);
 int linewhite(linenr_T lnum);
 void find_pattern_in_path(char_u *ptr, int dir, int len, int whole, int skip_comments, int type, long count, int action, linenr_T start_lnum, linenr_T end_lnum);
 int read_viminfo_search_pattern(vir_T *virp, int force);
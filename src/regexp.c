@@ -595,6 +595,8 @@ init_class_tab(void)
 #define RF_HASNL    4	/* can match a NL */
 #define RF_ICOMBINE 8	/* ignore combining characters */
 #define RF_LOOKBH   16	/* uses "\@<=" or "\@<!" */
+#define RF_POSITION 32	/* uses "\%#", "\%V", "\%'m", "\%l", "\%v", "\%^" or
+			   "\%$" */
 
 /*
  * Global work variables for vim_regcomp().
@@ -751,6 +753,17 @@ re_lookbehind(regprog_T *prog)
     return (prog->regflags & RF_LOOKBH);
 }
 
+/*
+ * Return TRUE if a match of compiled regular expression "prog" depends on
+ * more than the text of the line: the cursor position, the Visual area, a
+ * mark, the line number, the window or the first or last line.
+ */
+    int
+re_uses_position(regprog_T *prog)
+{
+    return (prog->regflags & RF_POSITION);
+}
+
 /*
  * Check for an equivalence class name "[=a=]".  "pp" points to the '['.
  * Returns a character representing the class. Zero means that no item was
@@ -2199,18 +2212,22 @@ regatom(int *flagp)
 		 * pattern -- regardless of whether or not it makes sense. */
 		case '^':
 		    ret = regnode(RE_BOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '$':
 		    ret = regnode(RE_EOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '#':
 		    ret = regnode(CURSOR);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'V':
 		    ret = regnode(RE_VISUAL);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'C':
@@ -2333,6 +2350,7 @@ regatom(int *flagp)
 				  /* "\%'m", "\%<'m" and "\%>'m": Mark */
 				  c = getchr();
 				  ret = regnode(RE_MARK);
+				  regflags |= RF_POSITION;
 				  if (ret == JUST_CALC_SIZE)
 				      regsize += 2;
 				  else
@@ -2349,11 +2367,15 @@ regatom(int *flagp)
 				      ret = regnode(RE_LNUM);
 				      if (save_prev_at_start)
 					  at_start = TRUE;
+				      regflags |= RF_POSITION;
 				  }
 				  else if (c == 'c')
 				      ret = regnode(RE_COL);
 				  else
+				  {
 				      ret = regnode(RE_VCOL);
+				      regflags |= RF_POSITION;
+				  }
 				  if (ret == JUST_CALC_SIZE)
 				      regsize += 5;
 				  else
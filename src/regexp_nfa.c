@@ -1548,18 +1548,22 @@ nfa_regatom(void)
 		 * pattern -- regardless of whether or not it makes sense. */
 		case '^':
 		    EMIT(NFA_BOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '$':
 		    EMIT(NFA_EOF);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case '#':
 		    EMIT(NFA_CURSOR);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'V':
 		    EMIT(NFA_VISUAL);
+		    regflags |= RF_POSITION;
 		    break;
 
 		case 'C':
@@ -1619,15 +1623,19 @@ nfa_regatom(void)
 				     cmp == '>' ? NFA_LNUM_GT : NFA_LNUM);
 				if (save_prev_at_start)
 				    at_start = TRUE;
+				regflags |= RF_POSITION;
 			    }
 			    else if (c == 'c')
 				/* \%{n}c  \%{n}<c  \%{n}>c  */
 				EMIT(cmp == '<' ? NFA_COL_LT :
 				     cmp == '>' ? NFA_COL_GT : NFA_COL);
 			    else
+			    {
 				/* \%{n}v  \%{n}<v  \%{n}>v  */
 				EMIT(cmp == '<' ? NFA_VCOL_LT :
 				     cmp == '>' ? NFA_VCOL_GT : NFA_VCOL);
+				regflags |= RF_POSITION;
+			    }
 #if VIM_SIZEOF_INT < VIM_SIZEOF_LONG
 			    if (n > INT_MAX)
 			    {
@@ -1643,6 +1651,7 @@ nfa_regatom(void)
 			    /* \%'m  \%<'m  \%>'m  */
 			    EMIT(cmp == '<' ? NFA_MARK_LT :
 				 cmp == '>' ? NFA_MARK_GT : NFA_MARK);
+			    regflags |= RF_POSITION;
 			    EMIT(getchr());
 			    break;
 			}
@@ -105,6 +105,13 @@ static int	screen_cur_row, screen_cur_col;	/* last known cursor position */
 
 #ifdef FEAT_SEARCH_EXTRA
 static match_T search_hl;	/* used for 'hlsearch' highlight matching */
+
+/*
+ * Matches for 'hlsearch' are cached per buffer, so that redrawing a line
+ * that didn't change doesn't require executing the regexp again.  Only
+ * possible when a match depends on nothing but the text of the line.
+ */
+# define HLS_CACHE_MAX_LINES 10000  /* max number of lines in the cache */
 #endif
 
 #if defined(FEAT_MENU) || defined(FEAT_FOLDING)
@@ -124,6 +131,18 @@ static int redrawing_for_callback = 0;
  */
 static schar_T	*current_ScreenLine;
 
+/*
+ * Window that is being redrawn completely by win_update().  While set,
+ * screen_line() may scroll the rest of the window up when the line it is
+ * about to draw is already on the screen further down.
+ */
+static win_T	*scroll_match_wp = NULL;
+static unsigned	*scroll_match_hash = NULL;  /* hash for each window row */
+static int	scroll_match_hash_len = 0;  /* allocated size of hash array */
+static int	scroll_match_hash_row = -1; /* hashes valid from this row */
+static void scroll_match_start(win_T *wp);
+static void screen_line_scroll_match(int row, int endcol, int clear_width);
+
 static void win_update(win_T *wp);
 static void win_draw_end(win_T *wp, int c1, int c2, int row, int endrow, hlf_T hl);
 #ifdef FEAT_FOLDING
@@ -145,6 +164,10 @@ static void init_search_hl(win_T *wp);
 static void prepare_search_hl(win_T *wp, linenr_T lnum);
 static void next_search_hl(win_T *win, match_T *shl, linenr_T lnum, colnr_T mincol, matchitem_T *cur);
 static int next_search_hl_pos(match_T *shl, linenr_T lnum, posmatch_T *pos, colnr_T mincol);
+static hlscache_T *hls_cache_check(buf_T *buf);
+static void hls_cache_free_lines(hlscache_T *hc, int idx, int count);
+static hlsmatch_T *hls_cache_find(hlscache_T *hc, linenr_T lnum, colnr_T matchcol);
+static void hls_cache_add(hlscache_T *hc, linenr_T lnum, colnr_T matchcol, colnr_T startcol, colnr_T endcol);
 #endif
 static void screen_start_highlight(int attr);
 static void screen_char(unsigned off, int row, int col);
@@ -1826,6 +1849,11 @@ win_update(win_T *wp)
 	redraw_win_toolbar(wp);
 #endif
 
+    /* When all rows are redrawn, text that is already on the screen below
+     * the row being drawn can be scrolled into place. */
+    if (mid_start == 0 && mid_end >= wp->w_height)
+	scroll_match_start(wp);
+
     /*
      * Update all the window rows.
      */
@@ -2176,6 +2204,7 @@ win_update(win_T *wp)
     /*
      * End of loop over all window lines.
      */
+    scroll_match_start(NULL);
 
 #ifdef FEAT_VTP
     /* Rewrite the character at the end of the screen line. */
@@ -6049,6 +6078,174 @@ char_needs_redraw(int off_from, int off_to, int cols)
     return FALSE;
 }
 
+/*
+ * Return TRUE when the "cols" screen cells starting at "off_from" are exactly
+ * equal to the cells at "off_to", comparing each of the screen arrays as one
+ * block.  When this is TRUE char_needs_redraw() would return FALSE for every
+ * cell, thus the per-character loop in screen_line() can be skipped.
+ */
+    static int
+screen_cells_equal(unsigned off_from, unsigned off_to, int cols)
+{
+    if (cols <= 0)
+	return TRUE;
+    if (memcmp(ScreenLines + off_from, ScreenLines + off_to,
+					       (size_t)cols * sizeof(schar_T)) != 0
+	    || memcmp(ScreenAttrs + off_from, ScreenAttrs + off_to,
+					      (size_t)cols * sizeof(sattr_T)) != 0)
+	return FALSE;
+#ifdef FEAT_MBYTE
+    if (enc_utf8)
+    {
+	int	i;
+
+	if (memcmp(ScreenLinesUC + off_from, ScreenLinesUC + off_to,
+					    (size_t)cols * sizeof(u8char_T)) != 0)
+	    return FALSE;
+	/* Composing characters only matter for non-ASCII cells. */
+	for (i = 0; i < cols; ++i)
+	    if (ScreenLinesUC[off_from + i] != 0
+			  && comp_char_differs(off_from + i, off_to + i))
+		return FALSE;
+    }
+    if (enc_dbcs == DBCS_JPNU
+	    && memcmp(ScreenLines2 + off_from, ScreenLines2 + off_to,
+					     (size_t)cols * sizeof(schar_T)) != 0)
+	return FALSE;
+#endif
+    return TRUE;
+}
+
+/*
+ * Compute a hash for the "cols" screen cells starting at "off".  Composing
+ * characters are not included, cells with the same hash still need to be
+ * compared with screen_cells_equal().
+ */
+    static unsigned
+screen_cells_hash(unsigned off, int cols)
+{
+    unsigned	hash = 2166136261u;
+    int		i;
+
+    for (i = 0; i < cols; ++i)
+    {
+	hash = (hash ^ ScreenLines[off + i]) * 16777619u;
+	hash = (hash ^ (unsigned)ScreenAttrs[off + i]) * 16777619u;
+#ifdef FEAT_MBYTE
+	if (enc_utf8)
+	    hash = (hash ^ (unsigned)ScreenLinesUC[off + i]) * 16777619u;
+#endif
+    }
+    return hash;
+}
+
+/*
+ * Start or stop matching screen lines drawn for window "wp" against the
+ * lines further down in the window.  Only to be used when all the rows of
+ * the window are going to be redrawn, since rows below the current one are
+ * moved.  "wp" is NULL to stop.
+ */
+    static void
+scroll_match_start(win_T *wp)
+{
+    scroll_match_wp = NULL;
+    scroll_match_hash_row = -1;
+    if (wp == NULL || !redrawing() || wp->w_height < 4
+	    /* Scrolling in a vertically split window without a way to set
+	     * the scroll region redraws the cells, no use doing that. */
+	    || (wp->w_width != Columns && !(scroll_region && *T_CSV != NUL)))
+	return;
+    if (scroll_match_hash_len < wp->w_height)
+    {
+	vim_free(scroll_match_hash);
+	scroll_match_hash = (unsigned *)lalloc(
+			     (long_u)(wp->w_height * sizeof(unsigned)), FALSE);
+	scroll_match_hash_len = scroll_match_hash == NULL ? 0 : wp->w_height;
+	if (scroll_match_hash == NULL)
+	    return;
+    }
+    scroll_match_wp = wp;
+}
+
+/*
+ * Called by screen_line() before drawing screen row "row" of
+ * "scroll_match_wp".  When the row is going to change and the new text is
+ * found in a row below it, scroll the rows in between out of the window.
+ * The following rows are then likely to match as well and don't need to be
+ * output again.  Mostly useful after closing a fold or deleting lines in a
+ * way that win_update() could not predict.
+ */
+    static void
+screen_line_scroll_match(int row, int endcol, int clear_width)
+{
+    win_T	*wp = scroll_match_wp;
+    int		wrow = row - W_WINROW(wp);
+    int		width = wp->w_width;
+    unsigned	off_from = (unsigned)(current_ScreenLine - ScreenLines);
+    unsigned	hash;
+    int		r;
+    int		i;
+
+    if (wrow < 0 || wrow >= wp->w_height - 2)
+	return;
+    /* Only a line that fills the window width can be matched, the cells
+     * after "endcol" are either cleared or part of the line. */
+    if (clear_width > 0 ? clear_width != width
+			: (-clear_width != width || endcol != width))
+	return;
+    if (endcol > width)
+	return;
+
+    /* Blank out the cells that screen_line() will clear, so that the line
+     * can be compared as a whole. */
+    for (i = endcol; i < width; ++i)
+    {
+	current_ScreenLine[i] = ' ';
+	ScreenAttrs[off_from + i] = 0;
+#ifdef FEAT_MBYTE
+	if (enc_utf8)
+	    ScreenLinesUC[off_from + i] = 0;
+#endif
+    }
+
+    /* Nothing to do when the row doesn't change. */
+    if (screen_cells_equal(off_from, LineOffset[row] + wp->w_wincol, width))
+	return;
+
+    /* Lines with only one character, such as empty lines and the "~"
+     * lines, match too easily, don't scroll for those. */
+    for (i = 1; i < width; ++i)
+	if (!screen_cells_equal(off_from, off_from + i, 1))
+	    break;
+    if (i == width)
+	return;
+
+    /* The rows below the current one have not been drawn yet, compute
+     * their hash once. */
+    if (scroll_match_hash_row < 0 || scroll_match_hash_row > wrow + 1)
+    {
+	for (r = wrow + 1; r < wp->w_height; ++r)
+	    scroll_match_hash[r] = screen_cells_hash(
+		       LineOffset[W_WINROW(wp) + r] + wp->w_wincol, width);
+	scroll_match_hash_row = wrow + 1;
+    }
+
+    hash = screen_cells_hash(off_from, width);
+    for (r = wrow + 1; r < wp->w_height; ++r)
+	if (scroll_match_hash[r] == hash
+		&& screen_cells_equal(off_from,
+			LineOffset[W_WINROW(wp) + r] + wp->w_wincol, width))
+	    break;
+    if (r == wp->w_height)
+	return;
+
+    /* Scrolling changes the rows below, their hashes are computed again
+     * when needed.  When scrolling isn't possible don't try again. */
+    scroll_match_hash_row = -1;
+    if (win_del_lines(wp, wrow, r - wrow, FALSE, FALSE, 0) == FAIL)
+	scroll_match_wp = NULL;
+}
+
 #if defined(FEAT_TERMINAL) || defined(PROTO)
 /*
  * Return the index in ScreenLines[] for the current screen line.
@@ -6113,6 +6310,13 @@ screen_line(
     clip_may_clear_selection(row, row);
 # endif
 
+    if (scroll_match_wp != NULL && coloff == scroll_match_wp->w_wincol
+#ifdef FEAT_RIGHTLEFT
+	    && !rlflag
+#endif
+	    )
+	screen_line_scroll_match(row, endcol, clear_width);
+
     off_from = (unsigned)(current_ScreenLine - ScreenLines);
     off_to = LineOffset[row] + coloff;
 #ifdef FEAT_MBYTE
@@ -6147,6 +6351,19 @@ screen_line(
     }
 #endif /* FEAT_RIGHTLEFT */
 
+    /* Most of the time a redrawn line is identical to what is already on
+     * the screen.  Compare the whole line at once then, instead of going
+     * through the cells one by one.  Not for hpterm, stopping highlighting
+     * needs to be done for every cell. */
+    if (col < endcol && !p_wiv
+	    && screen_cells_equal(off_from, off_to, endcol - col))
+    {
+	off_to += endcol - col;
+	off_from += endcol - col;
+	col = endcol;
+	redraw_this = FALSE;
+    }
+
     redraw_next = char_needs_redraw(off_from, off_to, endcol - col);
 
     while (col < endcol)
@@ -7874,6 +8091,8 @@ next_search_hl(
     linenr_T	l;
     colnr_T	matchcol;
     long	nmatched;
+    hlscache_T	*hc;
+    hlsmatch_T	*hm;
 
     if (shl->lnum != 0)
     {
@@ -7937,7 +8156,22 @@ next_search_hl(
 	    matchcol = shl->rm.endpos[0].col;
 
 	shl->lnum = lnum;
-	if (shl->rm.regprog != NULL)
+	hc = shl == &search_hl ? hls_cache_check(shl->buf) : NULL;
+	if (hc != NULL && (hm = hls_cache_find(hc, lnum, matchcol)) != NULL)
+	{
+	    /* Found this search in the cache. */
+	    if (hm->hm_startcol == MAXCOL)
+		nmatched = 0;
+	    else
+	    {
+		nmatched = 1;
+		shl->rm.startpos[0].lnum = 0;
+		shl->rm.startpos[0].col = hm->hm_startcol;
+		shl->rm.endpos[0].lnum = 0;
+		shl->rm.endpos[0].col = hm->hm_endcol;
+	    }
+	}
+	else if (shl->rm.regprog != NULL)
 	{
 	    /* Remember whether shl->rm is using a copy of the regprog in
 	     * cur->match. */
@@ -7958,6 +8192,16 @@ next_search_hl(
 	    if (regprog_is_copy)
 		cur->match.regprog = cur->hl.rm.regprog;
 
+	    if (hc != NULL && !called_emsg && !got_int && !timed_out)
+	    {
+		if (nmatched == 0)
+		    hls_cache_add(hc, lnum, matchcol, MAXCOL, 0);
+		else if (nmatched == 1 && shl->rm.startpos[0].lnum == 0
+					       && shl->rm.endpos[0].lnum == 0)
+		    hls_cache_add(hc, lnum, matchcol,
+			   shl->rm.startpos[0].col, shl->rm.endpos[0].col);
+	    }
+
 	    if (called_emsg || got_int || timed_out)
 	    {
 		/* Error while handling regexp: stop using this regexp. */
@@ -8053,6 +8297,209 @@ next_search_hl_pos(
     }
     return 0;
 }
+
+/*
+ * Return the 'hlsearch' cache of buffer "buf" when it can be used for the
+ * current search pattern.  Clears the cache when it was for another
+ * pattern.  Returns NULL when the cache can't be used.
+ */
+    static hlscache_T *
+hls_cache_check(buf_T *buf)
+{
+    hlscache_T	*hc = &buf->b_hls_cache;
+    regprog_T	*prog = search_hl.rm.regprog;
+    char_u	*pat = last_search_pat();
+
+    /* A match of a multi-line pattern or one with a look-behind may depend
+     * on other lines, and a pattern with "\%#" and the like on more than
+     * the text.  A "~" may stand for the last substitute string, which can
+     * change while the pattern stays the same. */
+    if (prog == NULL || pat == NULL || re_multiline(prog)
+			     || re_lookbehind(prog) || re_uses_position(prog)
+			     || vim_strchr(pat, '~') != NULL)
+	return NULL;
+
+    if (hc->hc_pat == NULL
+	    || STRCMP(hc->hc_pat, pat) != 0
+	    || hc->hc_magic != last_search_pat_magic()
+	    || hc->hc_ic != search_hl.rm.rmm_ic)
+    {
+	hls_cache_free(buf);
+	hc->hc_pat = vim_strsave(pat);
+	if (hc->hc_pat == NULL)
+	    return NULL;
+	hc->hc_magic = last_search_pat_magic();
+	hc->hc_ic = search_hl.rm.rmm_ic;
+	ga_init2(&hc->hc_lines, (int)sizeof(hlsline_T), 100);
+    }
+    return hc;
+}
+
+/*
+ * Free the cached matches in "hc" for "count" lines starting at index
+ * "idx".
+ */
+    static void
+hls_cache_free_lines(hlscache_T *hc, int idx, int count)
+{
+    int		i;
+    hlsline_T	*hl = (hlsline_T *)hc->hc_lines.ga_data;
+
+    for (i = idx; i < idx + count; ++i)
+    {
+	VIM_CLEAR(hl[i].hl_matches);
+	hl[i].hl_count = 0;
+    }
+}
+
+/*
+ * Find the cached result of searching line "lnum" from column "matchcol".
+ * Returns NULL when not cached.
+ */
+    static hlsmatch_T *
+hls_cache_find(hlscache_T *hc, linenr_T lnum, colnr_T matchcol)
+{
+    hlsline_T	*hl;
+    int		i;
+
+    if (lnum < hc->hc_top || lnum >= hc->hc_top + hc->hc_lines.ga_len)
+	return NULL;
+    hl = (hlsline_T *)hc->hc_lines.ga_data + (lnum - hc->hc_top);
+    for (i = 0; i < hl->hl_count; ++i)
+	if (hl->hl_matches[i].hm_matchcol == matchcol)
+	    return &hl->hl_matches[i];
+    return NULL;
+}
+
+/*
+ * Add the result of searching line "lnum" from column "matchcol" to the
+ * cache.  "startcol" is MAXCOL when there was no match.
+ * The cache holds a range of lines, when "lnum" is outside of it the range
+ * is extended, dropping lines at the other end when it gets too big.
+ */
+    static void
+hls_cache_add(
+    hlscache_T	*hc,
+    linenr_T	lnum,
+    colnr_T	matchcol,
+    colnr_T	startcol,
+    colnr_T	endcol)
+{
+    garray_T	*gap = &hc->hc_lines;
+    hlsline_T	*hl;
+    hlsmatch_T	*hm;
+    long	n;
+
+    if (gap->ga_len > 0 && (lnum < hc->hc_top - HLS_CACHE_MAX_LINES
+			|| lnum >= hc->hc_top + gap->ga_len + HLS_CACHE_MAX_LINES))
+    {
+	/* Far away from the cached lines: start again. */
+	hls_cache_free_lines(hc, 0, gap->ga_len);
+	gap->ga_len = 0;
+    }
+
+    if (gap->ga_len == 0)
+	hc->hc_top = lnum;
+    else if (lnum < hc->hc_top)
+    {
+	/* Insert entries at the start, drop them at the end if needed. */
+	n = hc->hc_top - lnum;
+	if (gap->ga_len + n > HLS_CACHE_MAX_LINES)
+	{
+	    hls_cache_free_lines(hc, HLS_CACHE_MAX_LINES - (int)n,
+			   gap->ga_len - (HLS_CACHE_MAX_LINES - (int)n));
+	    gap->ga_len = HLS_CACHE_MAX_LINES - (int)n;
+	}
+	if (ga_grow(gap, (int)n) == FAIL)
+	    return;
+	hl = (hlsline_T *)gap->ga_data;
+	mch_memmove(hl + n, hl, (size_t)gap->ga_len * sizeof(hlsline_T));
+	vim_memset(hl, 0, (size_t)n * sizeof(hlsline_T));
+	gap->ga_len += n;
+	hc->hc_top = lnum;
+    }
+    if (lnum >= hc->hc_top + gap->ga_len)
+    {
+	/* Append entries at the end, drop them at the start if needed. */
+	n = lnum - (hc->hc_top + gap->ga_len) + 1;
+	if (gap->ga_len + n > HLS_CACHE_MAX_LINES)
+	{
+	    int drop = gap->ga_len + (int)n - HLS_CACHE_MAX_LINES;
+
+	    hls_cache_free_lines(hc, 0, drop);
+	    hl = (hlsline_T *)gap->ga_data;
+	    mch_memmove(hl, hl + drop,
+			     (size_t)(gap->ga_len - drop) * sizeof(hlsline_T));
+	    gap->ga_len -= drop;
+	    hc->hc_top += drop;
+	}
+	if (ga_grow(gap, (int)n) == FAIL)
+	    return;
+	vim_memset((hlsline_T *)gap->ga_data + gap->ga_len, 0,
+						  (size_t)n * sizeof(hlsline_T));
+	gap->ga_len += n;
+    }
+
+    hl = (hlsline_T *)gap->ga_data + (lnum - hc->hc_top);
+    hm = (hlsmatch_T *)vim_realloc(hl->hl_matches,
+				 (hl->hl_count + 1) * sizeof(hlsmatch_T));
+    if (hm == NULL)
+	return;
+    hl->hl_matches = hm;
+    hm += hl->hl_count++;
+    hm->hm_matchcol = matchcol;
+    hm->hm_startcol = startcol;
+    hm->hm_endcol = endcol;
+}
+#endif
+
+#if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+/*
+ * Free the cached 'hlsearch' matches of buffer "buf".
+ */
+    void
+hls_cache_free(buf_T *buf)
+{
+    hlscache_T	*hc = &buf->b_hls_cache;
+
+    if (hc->hc_lines.ga_data != NULL)
+	hls_cache_free_lines(hc, 0, hc->hc_lines.ga_len);
+    ga_clear(&hc->hc_lines);
+    VIM_CLEAR(hc->hc_pat);
+}
+
+/*
+ * Called by the memline functions when the text of buffer "buf" changes:
+ * "xtra" is 1 when line "lnum" was inserted, -1 when line "lnum" was deleted
+ * and 0 when line "lnum" was replaced.
+ * Cached lines below an inserted or deleted line are dropped, they are
+ * likely not to be displayed before they are needed again.
+ */
+    void
+hls_cache_changed(buf_T *buf, linenr_T lnum, int xtra)
+{
+    hlscache_T	*hc = &buf->b_hls_cache;
+    int		idx;
+
+    if (hc->hc_lines.ga_len == 0)
+	return;
+    if (xtra != 0 && (lnum < hc->hc_top || (xtra > 0 && lnum == hc->hc_top)))
+    {
+	/* Above the cached lines, only need to adjust the line number. */
+	hc->hc_top += xtra;
+	return;
+    }
+    idx = lnum - hc->hc_top;
+    if (idx < 0 || idx >= hc->hc_lines.ga_len)
+	return;
+    if (xtra == 0)
+	hls_cache_free_lines(hc, idx, 1);
+    else
+    {
+	hls_cache_free_lines(hc, idx, hc->hc_lines.ga_len - idx);
+	hc->hc_lines.ga_len = idx;
+    }
+}
 #endif
 
       static void
@@ -9101,6 +9548,8 @@ free_screenlines(void)
     vim_free(LineOffset);
     vim_free(LineWraps);
     vim_free(TabPageIdxs);
+    VIM_CLEAR(scroll_match_hash);
+    scroll_match_hash_len = 0;
 }
 
     void
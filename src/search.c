@@ -15,6 +15,7 @@
 #ifdef FEAT_EVAL
 static void set_vv_searchforward(void);
 static int first_submatch(regmmatch_T *rp);
+static void match_index_clear(void);
 #endif
 static int check_prevcol(char_u *linep, int col, int ch, int *prevcol);
 static int inmacro(char_u *, char_u *);
@@ -351,6 +352,9 @@ free_search_patterns(void)
 {
     vim_free(spats[0].pat);
     vim_free(spats[1].pat);
+# ifdef FEAT_EVAL
+    match_index_clear();
+# endif
 
 # ifdef FEAT_RIGHTLEFT
     if (mr_pattern_alloced)
@@ -523,6 +527,17 @@ last_search_pat(void)
     return spats[last_idx].pat;
 }
 
+#if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+/*
+ * Return whether the last used search pattern is used with 'magic'.
+ */
+    int
+last_search_pat_magic(void)
+{
+    return spats[last_idx].magic;
+}
+#endif
+
 /*
  * Reset search direction to forward.  For "gd" and "gD" commands.
  */
@@ -4898,6 +4913,242 @@ is_one_char(char_u *pattern, int move, pos_T *cur, int direction)
     return result;
 }
 
+#if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Index of the matches of a pattern in the current buffer, for
+ * searchcount().  Building it may stop at the time limit, the next call
+ * continues where it stopped, as long as the buffer and the pattern didn't
+ * change.
+ */
+static int	    mi_fnum = 0;	/* buffer number, zero when not used */
+static varnumber_T  mi_changedtick;	/* b:changedtick of the buffer */
+static char_u	    *mi_pat = NULL;	/* the pattern */
+static int	    mi_magic;		/* 'magic' used for "mi_pat" */
+static int	    mi_ic;		/* ignore case used for "mi_pat" */
+static garray_T	    mi_matches = {0, 0, 0, 0, NULL}; /* lpos_T start of
+						   each match found */
+static lpos_T	    mi_next;		/* continue searching here, lnum is
+					   zero when the buffer was done */
+static colnr_T	    mi_prev_col;	/* column just after the previous
+					   match in line "mi_next.lnum" */
+
+/*
+ * Clear the index of matches.
+ */
+    static void
+match_index_clear(void)
+{
+    ga_clear(&mi_matches);
+    VIM_CLEAR(mi_pat);
+    mi_fnum = 0;
+}
+
+/*
+ * Count the matches of pattern "pat" in the current buffer.  Uses the last
+ * search pattern when "pat" is NULL or empty.
+ * Matches found before are reused when the buffer and pattern did not
+ * change, unless "recompute" is TRUE.
+ * Searching stops after "time_limit" msec and when "maxcount" matches were
+ * found, when not zero.
+ * Sets "*total" to the number of matches found, "*current" to the number of
+ * the match at or before "pos" (zero when there is none, or "pos" is after
+ * where searching stopped) and "*exact" to TRUE when a match starts at
+ * "pos".
+ * Returns zero when the whole buffer was searched, one when searching
+ * stopped at the time limit and two when it stopped at "maxcount".
+ * Returns -1 when the pattern is invalid.
+ */
+    int
+search_count(
+    char_u	*pat,
+    pos_T	*pos,
+    int		recompute,
+    long	time_limit UNUSED,
+    long	maxcount,
+    long	*current,
+    long	*total,
+    int		*exact)
+{
+    regmmatch_T	regmatch;
+    int		magic;
+    proftime_T	tm;
+    int		timed_out = FALSE;
+    int		result = 0;
+    linenr_T	lnum;
+    colnr_T	col;
+    lpos_T	*mp;
+    long	nmatched;
+    int		lo, hi;
+
+    *current = 0;
+    *total = 0;
+    *exact = FALSE;
+
+    if (pat == NULL || *pat == NUL)
+    {
+	if (spats[last_idx].pat == NULL)
+	{
+	    EMSG(_(e_noprevre));
+	    return -1;
+	}
+	pat = spats[last_idx].pat;
+	magic = spats[last_idx].magic;
+    }
+    else
+	magic = p_magic;
+    if (search_regcomp(pat, RE_SEARCH, RE_LAST, SEARCH_KEEP, &regmatch)
+								       == FAIL)
+	return -1;
+
+    /* A match with "\%#" and the like depends on more than the text. */
+    if (recompute || re_uses_position(regmatch.regprog)
+	    || mi_fnum != curbuf->b_fnum
+	    || mi_changedtick != CHANGEDTICK(curbuf)
+	    || mi_pat == NULL || STRCMP(mi_pat, pat) != 0
+	    || mi_magic != magic || mi_ic != regmatch.rmm_ic)
+    {
+	match_index_clear();
+	mi_pat = vim_strsave(pat);
+	if (mi_pat == NULL)
+	{
+	    vim_regfree(regmatch.regprog);
+	    return -1;
+	}
+	mi_fnum = curbuf->b_fnum;
+	mi_changedtick = CHANGEDTICK(curbuf);
+	mi_magic = magic;
+	mi_ic = regmatch.rmm_ic;
+	ga_init2(&mi_matches, (int)sizeof(lpos_T), 100);
+	mi_next.lnum = 1;
+	mi_next.col = 0;
+	mi_prev_col = MAXCOL;
+    }
+
+#ifdef FEAT_RELTIME
+    profile_setlimit(time_limit, &tm);
+#endif
+    lnum = mi_next.lnum;
+    col = mi_next.col;
+    while (lnum > 0 && lnum <= curbuf->b_ml.ml_line_count)
+    {
+	if (maxcount > 0 && mi_matches.ga_len >= maxcount)
+	{
+	    result = 2;
+	    break;
+	}
+	nmatched = vim_regexec_multi(&regmatch, curwin, curbuf, lnum, col,
+								&tm, &timed_out);
+	if (called_emsg || got_int || timed_out)
+	{
+	    result = 1;
+	    break;
+	}
+	if (nmatched == 0)
+	{
+	    /* No more matches in this line. */
+	    ++lnum;
+	    col = 0;
+	    mi_prev_col = MAXCOL;
+#ifdef FEAT_RELTIME
+	    if (time_limit > 0 && profile_passed_limit(&tm))
+	    {
+		result = 1;
+		break;
+	    }
+#endif
+	    continue;
+	}
+
+	if (regmatch.startpos[0].lnum > 0)
+	{
+	    /* Match starts in a following line. */
+	    lnum += regmatch.startpos[0].lnum;
+	    regmatch.endpos[0].lnum -= regmatch.startpos[0].lnum;
+	    mi_prev_col = MAXCOL;
+	}
+
+	/* Like with ":s//gn" an empty match just after the previous match
+	 * doesn't count, search again one character further. */
+	if (col == mi_prev_col && regmatch.endpos[0].lnum == 0
+					       && col == regmatch.endpos[0].col)
+	{
+	    char_u *ptr = ml_get_buf(curbuf, lnum, FALSE) + col;
+
+	    if (*ptr == NUL)
+	    {
+		++lnum;
+		col = 0;
+		mi_prev_col = MAXCOL;
+	    }
+	    else
+		col += MB_PTR2LEN(ptr);
+	}
+	else
+	{
+	    if (ga_grow(&mi_matches, 1) == OK)
+	    {
+		mp = (lpos_T *)mi_matches.ga_data + mi_matches.ga_len++;
+		mp->lnum = lnum;
+		mp->col = regmatch.startpos[0].col;
+	    }
+	    if (regmatch.endpos[0].lnum > 0)
+	    {
+		/* Multi-line match, continue in the next line. */
+		++lnum;
+		col = 0;
+		mi_prev_col = MAXCOL;
+		continue;
+	    }
+	    col = regmatch.endpos[0].col;
+	    mi_prev_col = col;
+	}
+
+	/* At the end of the line only a pattern that can match a line
+	 * break may match again. */
+	if (col > 0 && *(ml_get_buf(curbuf, lnum, FALSE) + col) == NUL
+					    && !re_multiline(regmatch.regprog))
+	{
+	    ++lnum;
+	    col = 0;
+	    mi_prev_col = MAXCOL;
+	}
+    }
+    vim_regfree(regmatch.regprog);
+
+    if (result == 0)
+	mi_next.lnum = 0;
+    else
+    {
+	mi_next.lnum = lnum;
+	mi_next.col = col;
+    }
+    *total = mi_matches.ga_len;
+
+    /* Binary search for the last match at or before "pos". */
+    if (mi_next.lnum == 0 || pos->lnum < mi_next.lnum
+		    || (pos->lnum == mi_next.lnum && pos->col < mi_next.col))
+    {
+	mp = (lpos_T *)mi_matches.ga_data;
+	lo = 0;
+	hi = mi_matches.ga_len;
+	while (lo < hi)
+	{
+	    int mid = (lo + hi) / 2;
+
+	    if (mp[mid].lnum < pos->lnum
+		    || (mp[mid].lnum == pos->lnum && mp[mid].col <= pos->col))
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	*current = lo;
+	*exact = lo > 0 && mp[lo - 1].lnum == pos->lnum
+						  && mp[lo - 1].col == pos->col;
+    }
+    return result;
+}
+#endif
+
 #if defined(FEAT_LISP) || defined(FEAT_CINDENT) || defined(FEAT_TEXTOBJ) \
 	|| defined(PROTO)
 /*
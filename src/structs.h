@@ -343,6 +343,7 @@ struct u_entry
     linenr_T	ue_lcount;	/* linecount when u_save called */
     char_u	**ue_array;	/* array of lines in undo block */
     long	ue_size;	/* number of lines in ue_array */
+    long	ue_maxsize;	/* number of lines allocated for ue_array */
 #ifdef U_DEBUG
     int		ue_magic;	/* magic number to check allocation */
 #endif
@@ -1268,12 +1269,15 @@ struct listvar_S
     listitem_T	*lv_last;	/* last item, NULL if none */
     listwatch_T	*lv_watch;	/* first watcher, NULL if none */
     listitem_T	*lv_idx_item;	/* when not NULL item at index "lv_idx" */
+    listitem_T	**lv_index;	/* items by index, NULL if not allocated */
     list_T	*lv_copylist;	/* copied list used by deepcopy() */
     list_T	*lv_used_next;	/* next list in used lists list */
     list_T	*lv_used_prev;	/* previous list in used lists list */
     int		lv_refcount;	/* reference count */
     int		lv_len;		/* number of items */
     int		lv_idx;		/* cached index of an item */
+    int		lv_index_len;	/* nr of valid items in "lv_index" */
+    int		lv_index_size;	/* allocated size of "lv_index" */
     int		lv_copyID;	/* ID used by deepcopy() */
     char	lv_lock;	/* zero, VAR_LOCKED, VAR_FIXED */
 };
@@ -1329,6 +1333,23 @@ struct dictvar_S
     dict_T	*dv_used_prev;	/* previous dict in used dicts list */
 };
 
+/*
+ * Result of parsing the start of an Ex command line, remembered for a line
+ * that is executed again, e.g. a line of a user function.  Only a line
+ * without command modifiers and without a range is remembered.
+ */
+typedef struct
+{
+    int		cp_state;	/* CP_UNKNOWN, CP_CACHED or CP_NOCACHE */
+    int		cp_cmdidx;	/* index of the command (cmdidx_T) */
+    int		cp_cmd;		/* offset of the command name in the line */
+    int		cp_arg;		/* offset of the text after the name */
+} cmdparse_T;
+
+#define CP_UNKNOWN	0	/* line was not parsed yet */
+#define CP_CACHED	1	/* "cp_cmdidx", "cp_cmd" and "cp_arg" are valid */
+#define CP_NOCACHE	2	/* line must always be parsed */
+
 #if defined(FEAT_EVAL) || defined(PROTO)
 typedef struct funccall_S funccall_T;
 
@@ -1343,6 +1364,8 @@ typedef struct
     int		uf_cleared;	/* func_clear() was already called */
     garray_T	uf_args;	/* arguments */
     garray_T	uf_lines;	/* function lines */
+    cmdparse_T	*uf_parsed;	/* parsed commands, one per line in
+				   "uf_lines"; NULL when not allocated */
 #ifdef FEAT_PROFILE
     int		uf_profiling;	/* TRUE when func is being profiled */
     /* profiling the function as a whole */
@@ -1384,6 +1407,9 @@ struct funccall_S
 	dictitem_T	var;		/* variable (without room for name) */
 	char_u	room[VAR_SHORT_LEN];	/* room for the name */
     } fixvar[FIXVAR_CNT];
+    int		fc_lazy_args;	/* index in fixvar[] of a:0, a:000,
+				   a:firstline and a:lastline while they were
+				   not added to "l_avars" yet, -1 otherwise */
     dict_T	l_vars;		/* l: local function variables */
     dictitem_T	l_vars_var;	/* variable for l: scope */
     dict_T	l_avars;	/* a: argument variables */
@@ -1494,14 +1520,29 @@ struct jobvar_S
 /*
  * Structures to hold info about a Channel.
  */
+/*
+ * Read buffer of a channel part.  Text read is appended at the end, messages
+ * are parsed where they are and consumed from the start.  The text is always
+ * followed by a NUL.
+ */
 struct readq_S
 {
-    char_u	*rq_buffer;
-    long_u	rq_buflen;
-    readq_T	*rq_next;
-    readq_T	*rq_prev;
+    char_u	*rq_alloc;	/* allocated memory, NULL if nothing read */
+    char_u	*rq_buffer;	/* start of the text in rq_alloc */
+    long_u	rq_buflen;	/* length of the text */
+    long_u	rq_size;	/* allocated size of rq_alloc */
 };
 
+/*
+ * State of json_decode_partial(): the part of a message decoded so far.
+ */
+typedef struct
+{
+    garray_T	jp_stack;	/* lists and dicts that are not complete */
+    typval_T	jp_res;		/* the outer list or dict */
+    long_u	jp_used;	/* number of bytes decoded so far */
+} json_partial_T;
+
 struct writeq_S
 {
     garray_T	wq_ga;
@@ -1533,6 +1574,7 @@ typedef enum
     MODE_RAW,
     MODE_JSON,
     MODE_JS,
+    MODE_MSGPACK,
 } ch_mode_T;
 
 typedef enum {
@@ -1585,7 +1627,8 @@ typedef struct {
     job_io_T	ch_io;
     int		ch_timeout;	/* request timeout in msec */
 
-    readq_T	ch_head;	/* header for circular raw read queue */
+    readq_T	ch_readq;	/* buffer for raw read text */
+    json_partial_T ch_json_partial; /* JSON message decoded so far */
     jsonq_T	ch_json_head;	/* header for circular json read queue */
     int		ch_block_id;	/* ID that channel_read_json_block() is
 				   waiting for */
@@ -1603,10 +1646,14 @@ typedef struct {
 				 * does not block, 1 simulate blocking */
     int		ch_nonblocking;	/* write() is non-blocking */
     writeq_T	ch_writeque;	/* header for write queue */
+    long_u	ch_write_queued; /* number of bytes in ch_writeque */
+    int		ch_close_written; /* close when ch_writeque is empty */
 
     cbq_T	ch_cb_head;	/* dummy node for per-request callbacks */
     char_u	*ch_callback;	/* call when a msg is not handled */
     partial_T	*ch_partial;
+    int		ch_batch;	/* "batch": pass up to this number of
+				 * messages to ch_callback as a list */
 
     bufref_T	ch_bufref;	/* buffer to read from or write to */
     int		ch_nomodifiable; /* TRUE when buffer can be 'nomodifiable' */
@@ -1651,6 +1698,13 @@ struct channel_S {
     partial_T	*ch_partial;
     char_u	*ch_close_cb;	/* call when channel is closed */
     partial_T	*ch_close_partial;
+    char_u	*ch_drain_cb;	/* call when write queue has drained */
+    partial_T	*ch_drain_partial;
+    long	ch_write_high;	/* "write_high": full above this */
+    long	ch_write_low;	/* "write_low": drained at this */
+    int		ch_write_full;	/* TRUE when more than ch_write_high bytes
+				 * are queued, until down to ch_write_low */
+    int		ch_drain_pending; /* TRUE when ch_drain_cb is to be invoked */
     int		ch_drop_never;
     int		ch_keep_open;	/* do not close on read error */
 
@@ -1713,11 +1767,16 @@ struct channel_S {
 #define JO2_NORESTORE	    0x2000	/* "norestore" */
 #define JO2_TERM_KILL	    0x4000	/* "term_kill" */
 #define JO2_ANSI_COLORS	    0x8000	/* "ansi_colors" */
+#define JO2_WRITE_HIGH	    0x10000	/* "write_high" */
+#define JO2_WRITE_LOW	    0x20000	/* "write_low" */
+#define JO2_DRAIN_CB	    0x40000	/* "drain_cb" */
+#define JO2_BATCH	    0x80000	/* "batch" */
 
 #define JO_MODE_ALL	(JO_MODE + JO_IN_MODE + JO_OUT_MODE + JO_ERR_MODE)
 #define JO_CB_ALL \
     (JO_CALLBACK + JO_OUT_CALLBACK + JO_ERR_CALLBACK + JO_CLOSE_CALLBACK)
 #define JO_TIMEOUT_ALL	(JO_TIMEOUT + JO_OUT_TIMEOUT + JO_ERR_TIMEOUT)
+#define JO2_WRITE_ALL	(JO2_WRITE_HIGH + JO2_WRITE_LOW + JO2_DRAIN_CB)
 
 /*
  * Options for job and channel commands.
@@ -1754,6 +1813,11 @@ typedef struct
     partial_T	*jo_close_partial; /* not referenced! */
     char_u	*jo_exit_cb;	/* not allocated! */
     partial_T	*jo_exit_partial; /* not referenced! */
+    char_u	*jo_drain_cb;	/* not allocated! */
+    partial_T	*jo_drain_partial; /* not referenced! */
+    long	jo_write_high;
+    long	jo_write_low;
+    int		jo_batch;
     int		jo_drop_never;
     int		jo_waittime;
     int		jo_timeout;
@@ -1933,6 +1997,36 @@ typedef struct {
 } synblock_T;
 
 
+#ifdef FEAT_SEARCH_EXTRA
+/*
+ * Cached 'hlsearch' matches, so that redrawing a line doesn't need to run the
+ * regexp again.  See hls_cache_find() in screen.c.
+ */
+typedef struct
+{
+    colnr_T	hm_matchcol;	/* column where searching started */
+    colnr_T	hm_startcol;	/* start of the match, MAXCOL for no match */
+    colnr_T	hm_endcol;	/* end of the match */
+} hlsmatch_T;
+
+/* Cached matches for one line. */
+typedef struct
+{
+    int		hl_count;	/* number of entries in hl_matches */
+    hlsmatch_T	*hl_matches;
+} hlsline_T;
+
+typedef struct
+{
+    char_u	*hc_pat;	/* pattern the matches are for, NULL when not
+				   used */
+    int		hc_magic;	/* 'magic' used for "hc_pat" */
+    int		hc_ic;		/* ignore case used for "hc_pat" */
+    linenr_T	hc_top;		/* line number of the first entry */
+    garray_T	hc_lines;	/* hlsline_T for lines from "hc_top" */
+} hlscache_T;
+#endif
+
 /*
  * buffer: structure that holds information about one file
  *
@@ -2392,6 +2486,10 @@ struct file_buffer
 				 * may use a different synblock_T. */
 #endif
 
+#ifdef FEAT_SEARCH_EXTRA
+    hlscache_T	b_hls_cache;	/* cached 'hlsearch' matches */
+#endif
+
 #ifdef FEAT_SIGNS
     signlist_T	*b_signlist;	/* list of signs to draw */
 # ifdef FEAT_NETBEANS_INTG
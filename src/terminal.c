@@ -82,9 +82,17 @@ typedef struct {
   VTermColor		bg;
 } cellattr_T;
 
+/* A run of cells with the same attributes. */
+typedef struct {
+    int		sr_cols;	/* number of cells */
+    cellattr_T	sr_attr;
+} sb_run_T;
+
 typedef struct sb_line_S {
     int		sb_cols;	/* can differ per line */
-    cellattr_T	*sb_cells;	/* allocated */
+    int		sb_nruns;	/* number of items in sb_runs */
+    sb_run_T	*sb_runs;	/* allocated, NULL when all cells have
+				 * sb_fill_attr */
     cellattr_T	sb_fill_attr;	/* for short line */
 } sb_line_T;
 
@@ -784,7 +792,7 @@ free_scrollback(term_T *term)
     int i;
 
     for (i = 0; i < term->tl_scrollback.ga_len; ++i)
-	vim_free(((sb_line_T *)term->tl_scrollback.ga_data + i)->sb_cells);
+	vim_free(((sb_line_T *)term->tl_scrollback.ga_data + i)->sb_runs);
     ga_clear(&term->tl_scrollback);
 }
 
@@ -1398,6 +1406,124 @@ equal_celattr(cellattr_T *a, cellattr_T *b)
 	&& a->bg.blue == b->bg.blue;
 }
 
+    static int
+same_color(VTermColor *a, VTermColor *b)
+{
+    return a->red == b->red
+	&& a->green == b->green
+	&& a->blue == b->blue
+	&& a->ansi_index == b->ansi_index;
+}
+
+/*
+ * Return TRUE when cell attributes "a" and "b" are the same.
+ */
+    static int
+same_cellattr(cellattr_T *a, cellattr_T *b)
+{
+    return a->width == b->width
+	&& a->attrs.bold == b->attrs.bold
+	&& a->attrs.underline == b->attrs.underline
+	&& a->attrs.italic == b->attrs.italic
+	&& a->attrs.blink == b->attrs.blink
+	&& a->attrs.reverse == b->attrs.reverse
+	&& a->attrs.strike == b->attrs.strike
+	&& a->attrs.font == b->attrs.font
+	&& a->attrs.dwl == b->attrs.dwl
+	&& a->attrs.dhl == b->attrs.dhl
+	&& same_color(&a->fg, &b->fg)
+	&& same_color(&a->bg, &b->bg);
+}
+
+/*
+ * Add "count" cells with attributes "attr" to the runs in "gap".
+ */
+    static void
+add_cell_run(garray_T *gap, cellattr_T *attr, int count)
+{
+    sb_run_T	*run;
+
+    if (gap->ga_len > 0)
+    {
+	run = (sb_run_T *)gap->ga_data + gap->ga_len - 1;
+	if (same_cellattr(&run->sr_attr, attr))
+	{
+	    run->sr_cols += count;
+	    return;
+	}
+    }
+    if (ga_grow(gap, 1) == OK)
+    {
+	run = (sb_run_T *)gap->ga_data + gap->ga_len;
+	run->sr_cols = count;
+	run->sr_attr = *attr;
+	++gap->ga_len;
+    }
+}
+
+/*
+ * Set the attributes of scrollback line "line" with "cols" cells from the
+ * runs in "gap".  Takes over the runs, "gap" is empty afterwards.
+ * Nothing is stored when all cells have the fill attribute.
+ */
+    static void
+set_sb_line(sb_line_T *line, int cols, garray_T *gap, cellattr_T *fill_attr)
+{
+    line->sb_cols = cols;
+    line->sb_fill_attr = *fill_attr;
+    if (gap->ga_len == 0 || (gap->ga_len == 1
+		&& same_cellattr(&((sb_run_T *)gap->ga_data)->sr_attr,
+								  fill_attr)))
+    {
+	line->sb_nruns = 0;
+	line->sb_runs = NULL;
+	ga_clear(gap);
+    }
+    else
+    {
+	sb_run_T *runs;
+
+	/* Do not keep the space for growing. */
+	runs = (sb_run_T *)vim_realloc(gap->ga_data,
+					       gap->ga_len * sizeof(sb_run_T));
+	line->sb_nruns = gap->ga_len;
+	line->sb_runs = runs == NULL ? gap->ga_data : runs;
+	ga_init(gap);
+    }
+}
+
+/*
+ * Get the attributes of cell "col" in scrollback line "line".
+ */
+    static cellattr_T *
+sb_line_cell(sb_line_T *line, int col)
+{
+    int i;
+
+    if (col >= 0 && col < line->sb_cols)
+	for (i = 0; i < line->sb_nruns; ++i)
+	{
+	    if (col < line->sb_runs[i].sr_cols)
+		return &line->sb_runs[i].sr_attr;
+	    col -= line->sb_runs[i].sr_cols;
+	}
+    return &line->sb_fill_attr;
+}
+
+/*
+ * Make room for one more line in the scrollback of "term".  The array grows
+ * by half its size, so that a long scrollback is not reallocated often.
+ */
+    static int
+scrollback_grow(term_T *term)
+{
+    garray_T *gap = &term->tl_scrollback;
+
+    if (gap->ga_growsize < gap->ga_len / 2)
+	gap->ga_growsize = gap->ga_len / 2;
+    return ga_grow(gap, 1);
+}
+
 /*
  * Add an empty scrollback line to "term".  When "lnum" is not zero, add the
  * line at this position.  Otherwise at the end.
@@ -1405,7 +1531,7 @@ equal_celattr(cellattr_T *a, cellattr_T *b)
     static int
 add_empty_scrollback(term_T *term, cellattr_T *fill_attr, int lnum)
 {
-    if (ga_grow(&term->tl_scrollback, 1) == OK)
+    if (scrollback_grow(term) == OK)
     {
 	sb_line_T *line = (sb_line_T *)term->tl_scrollback.ga_data
 				      + term->tl_scrollback.ga_len;
@@ -1421,7 +1547,8 @@ add_empty_scrollback(term_T *term, cellattr_T *fill_attr, int lnum)
 	    }
 	}
 	line->sb_cols = 0;
-	line->sb_cells = NULL;
+	line->sb_nruns = 0;
+	line->sb_runs = NULL;
 	line->sb_fill_attr = *fill_attr;
 	++term->tl_scrollback.ga_len;
 	return OK;
@@ -1442,7 +1569,6 @@ move_terminal_to_buffer(term_T *term)
     VTermPos	    pos;
     VTermScreenCell cell;
     cellattr_T	    fill_attr, new_fill_attr;
-    cellattr_T	    *p;
     VTermScreen	    *screen;
 
     if (term->tl_vterm == NULL)
@@ -1476,25 +1602,24 @@ move_terminal_to_buffer(term_T *term)
 		    add_scrollback_line_to_buffer(term, (char_u *)"", 0);
 	    }
 
-	    if (len == 0)
-		p = NULL;
-	    else
-		p = (cellattr_T *)alloc((int)sizeof(cellattr_T) * len);
-	    if ((p != NULL || len == 0)
-				     && ga_grow(&term->tl_scrollback, 1) == OK)
+	    if (scrollback_grow(term) == OK)
 	    {
 		garray_T    ga;
+		garray_T    ga_runs;
+		cellattr_T  attr;
 		int	    width;
 		sb_line_T   *line = (sb_line_T *)term->tl_scrollback.ga_data
 						  + term->tl_scrollback.ga_len;
 
 		ga_init2(&ga, 1, 100);
+		ga_init2(&ga_runs, sizeof(sb_run_T), 4);
 		for (pos.col = 0; pos.col < len; pos.col += width)
 		{
 		    if (vterm_screen_get_cell(screen, pos, &cell) == 0)
 		    {
 			width = 1;
-			vim_memset(p + pos.col, 0, sizeof(cellattr_T));
+			vim_memset(&attr, 0, sizeof(cellattr_T));
+			add_cell_run(&ga_runs, &attr, 1);
 			if (ga_grow(&ga, 1) == OK)
 			    ga.ga_len += utf_char2bytes(' ',
 					     (char_u *)ga.ga_data + ga.ga_len);
@@ -1503,7 +1628,8 @@ move_terminal_to_buffer(term_T *term)
 		    {
 			width = cell.width;
 
-			cell2cellattr(&cell, &p[pos.col]);
+			cell2cellattr(&cell, &attr);
+			add_cell_run(&ga_runs, &attr, width);
 
 			if (ga_grow(&ga, MB_MAXBYTES) == OK)
 			{
@@ -1516,9 +1642,7 @@ move_terminal_to_buffer(term_T *term)
 			}
 		    }
 		}
-		line->sb_cols = len;
-		line->sb_cells = p;
-		line->sb_fill_attr = new_fill_attr;
+		set_sb_line(line, len, &ga_runs, &new_fill_attr);
 		fill_attr = new_fill_attr;
 		++term->tl_scrollback.ga_len;
 
@@ -1531,8 +1655,6 @@ move_terminal_to_buffer(term_T *term)
 		}
 		ga_clear(&ga);
 	    }
-	    else
-		vim_free(p);
 	}
     }
 
@@ -1636,7 +1758,7 @@ term_enter_job_mode()
     {
 	ml_delete(curbuf->b_ml.ml_line_count, FALSE);
 	line = (sb_line_T *)gap->ga_data + gap->ga_len - 1;
-	vim_free(line->sb_cells);
+	vim_free(line->sb_runs);
 	--gap->ga_len;
     }
     check_cursor();
@@ -2577,7 +2699,7 @@ handle_pushline(int cols, const VTermScreenCell *cells, void *user)
 	curbuf = term->tl_buffer;
 	for (i = 0; i < todo; ++i)
 	{
-	    vim_free(((sb_line_T *)term->tl_scrollback.ga_data + i)->sb_cells);
+	    vim_free(((sb_line_T *)term->tl_scrollback.ga_data + i)->sb_runs);
 	    ml_delete(1, FALSE);
 	}
 	curbuf = curwin->w_buffer;
@@ -2588,15 +2710,16 @@ handle_pushline(int cols, const VTermScreenCell *cells, void *user)
 	    sizeof(sb_line_T) * term->tl_scrollback.ga_len);
     }
 
-    if (ga_grow(&term->tl_scrollback, 1) == OK)
+    if (scrollback_grow(term) == OK)
     {
-	cellattr_T	*p = NULL;
 	int		len = 0;
 	int		i;
 	int		c;
 	int		col;
 	sb_line_T	*line;
 	garray_T	ga;
+	garray_T	ga_runs;
+	cellattr_T	attr;
 	cellattr_T	fill_attr = term->tl_default_color;
 
 	/* do not store empty cells at the end */
@@ -2607,22 +2730,19 @@ handle_pushline(int cols, const VTermScreenCell *cells, void *user)
 		cell2cellattr(&cells[i], &fill_attr);
 
 	ga_init2(&ga, 1, 100);
-	if (len > 0)
-	    p = (cellattr_T *)alloc((int)sizeof(cellattr_T) * len);
-	if (p != NULL)
+	ga_init2(&ga_runs, sizeof(sb_run_T), 4);
+	for (col = 0; col < len; col += cells[col].width)
 	{
-	    for (col = 0; col < len; col += cells[col].width)
+	    if (ga_grow(&ga, MB_MAXBYTES) == FAIL)
 	    {
-		if (ga_grow(&ga, MB_MAXBYTES) == FAIL)
-		{
-		    ga.ga_len = 0;
-		    break;
-		}
-		for (i = 0; (c = cells[col].chars[i]) > 0 || i == 0; ++i)
-		    ga.ga_len += utf_char2bytes(c == NUL ? ' ' : c,
-					     (char_u *)ga.ga_data + ga.ga_len);
-		cell2cellattr(&cells[col], &p[col]);
+		ga.ga_len = 0;
+		break;
 	    }
+	    for (i = 0; (c = cells[col].chars[i]) > 0 || i == 0; ++i)
+		ga.ga_len += utf_char2bytes(c == NUL ? ' ' : c,
+					     (char_u *)ga.ga_data + ga.ga_len);
+	    cell2cellattr(&cells[col], &attr);
+	    add_cell_run(&ga_runs, &attr, cells[col].width);
 	}
 	if (ga_grow(&ga, 1) == FAIL)
 	    add_scrollback_line_to_buffer(term, (char_u *)"", 0);
@@ -2635,9 +2755,7 @@ handle_pushline(int cols, const VTermScreenCell *cells, void *user)
 
 	line = (sb_line_T *)term->tl_scrollback.ga_data
 						  + term->tl_scrollback.ga_len;
-	line->sb_cols = len;
-	line->sb_cells = p;
-	line->sb_fill_attr = fill_attr;
+	set_sb_line(line, len, &ga_runs, &fill_attr);
 	++term->tl_scrollback.ga_len;
 	++term->tl_scrollback_scrolled;
     }
@@ -3013,10 +3131,7 @@ term_get_attr(buf_T *buf, linenr_T lnum, int col)
     else
     {
 	line = (sb_line_T *)term->tl_scrollback.ga_data + lnum - 1;
-	if (col < 0 || col >= line->sb_cols)
-	    cellattr = &line->sb_fill_attr;
-	else
-	    cellattr = line->sb_cells + col;
+	cellattr = sb_line_cell(line, col);
     }
     return cell2attr(cellattr->attrs, cellattr->fg, cellattr->bg);
 }
@@ -3464,6 +3579,9 @@ create_vterm(term_T *term, int rows, int cols)
     term->tl_vterm = vterm;
     screen = vterm_obtain_screen(vterm);
     vterm_screen_set_callbacks(screen, &screen_callbacks, term);
+    /* Merge the damage of text in one row, instead of getting a callback for
+     * every character.  term_write_job_output() flushes the damage. */
+    vterm_screen_set_damage_merge(screen, VTERM_DAMAGE_ROW);
     /* TODO: depends on 'encoding'. */
     vterm_set_utf8(vterm, 1);
 
@@ -3586,15 +3704,6 @@ term_get_buf(typval_T *argvars, char *where)
     return buf;
 }
 
-    static int
-same_color(VTermColor *a, VTermColor *b)
-{
-    return a->red == b->red
-	&& a->green == b->green
-	&& a->blue == b->blue
-	&& a->ansi_index == b->ansi_index;
-}
-
     static void
 dump_term_color(FILE *fd, VTermColor *color)
 {
@@ -3852,25 +3961,29 @@ read_dump_file(FILE *fd, VTermPos *cursor_pos)
 	    /* End of a line: append it to the buffer. */
 	    if (ga_text.ga_data == NULL)
 		dump_is_corrupt(&ga_text);
-	    if (ga_grow(&term->tl_scrollback, 1) == OK)
+	    if (scrollback_grow(term) == OK)
 	    {
 		sb_line_T   *line = (sb_line_T *)term->tl_scrollback.ga_data
 						  + term->tl_scrollback.ga_len;
+		garray_T    ga_runs;
+		int	    i;
 
 		if (max_cells < ga_cell.ga_len)
 		    max_cells = ga_cell.ga_len;
-		line->sb_cols = ga_cell.ga_len;
-		line->sb_cells = ga_cell.ga_data;
-		line->sb_fill_attr = term->tl_default_color;
+		ga_init2(&ga_runs, sizeof(sb_run_T), 4);
+		for (i = 0; i < ga_cell.ga_len; ++i)
+		    add_cell_run(&ga_runs, (cellattr_T *)ga_cell.ga_data + i, 1);
+		set_sb_line(line, ga_cell.ga_len, &ga_runs,
+						       &term->tl_default_color);
 		++term->tl_scrollback.ga_len;
-		ga_init(&ga_cell);
+		ga_cell.ga_len = 0;
 
 		ga_append(&ga_text, NUL);
 		ml_append(curbuf->b_ml.ml_line_count, ga_text.ga_data,
 							ga_text.ga_len, FALSE);
 	    }
 	    else
-		ga_clear(&ga_cell);
+		ga_cell.ga_len = 0;
 	    ga_text.ga_len = 0;
 
 	    c = fgetc(fd);
@@ -4034,6 +4147,7 @@ read_dump_file(FILE *fd, VTermPos *cursor_pos)
     }
 
     ga_clear(&ga_text);
+    ga_clear(&ga_cell);
     vim_free(prev_char);
 
     return max_cells;
@@ -4230,9 +4344,8 @@ term_load_dump(typval_T *argvars, typval_T *rettv, int do_diff)
 		char_u *p2;
 		int	col;
 		sb_line_T   *sb_line = (sb_line_T *)term->tl_scrollback.ga_data;
-		cellattr_T *cellattr1 = (sb_line + lnum - 1)->sb_cells;
-		cellattr_T *cellattr2 = (sb_line + lnum + bot_lnum - 1)
-								    ->sb_cells;
+		sb_line_T   *sb_line1 = sb_line + lnum - 1;
+		sb_line_T   *sb_line2 = sb_line + lnum + bot_lnum - 1;
 
 		/* Make a copy, getting the second line will invalidate it. */
 		line1 = vim_strsave(ml_get(lnum));
@@ -4263,19 +4376,19 @@ term_load_dump(typval_T *argvars, typval_T *rettv, int do_diff)
 					|| cursor_pos1.col != cursor_pos2.col))
 			/* cursor in second but not in first */
 			textline[col] = '<';
-		    else if (cellattr1 != NULL && cellattr2 != NULL)
+		    else if (sb_line1->sb_cols > 0 && sb_line2->sb_cols > 0)
 		    {
-			if ((cellattr1 + col)->width
-						   != (cellattr2 + col)->width)
+			cellattr_T *cellattr1 = sb_line_cell(sb_line1, col);
+			cellattr_T *cellattr2 = sb_line_cell(sb_line2, col);
+
+			if (cellattr1->width != cellattr2->width)
 			    textline[col] = 'w';
-			else if (!same_color(&(cellattr1 + col)->fg,
-						   &(cellattr2 + col)->fg))
+			else if (!same_color(&cellattr1->fg, &cellattr2->fg))
 			    textline[col] = 'f';
-			else if (!same_color(&(cellattr1 + col)->bg,
-						   &(cellattr2 + col)->bg))
+			else if (!same_color(&cellattr1->bg, &cellattr2->bg))
 			    textline[col] = 'b';
-			else if (vtermAttr2hl((cellattr1 + col)->attrs)
-				   != vtermAttr2hl(((cellattr2 + col)->attrs)))
+			else if (vtermAttr2hl(cellattr1->attrs)
+					       != vtermAttr2hl(cellattr2->attrs))
 			    textline[col] = 'a';
 		    }
 		    p1 += len1;
@@ -4818,7 +4931,7 @@ f_term_scrape(typval_T *argvars, typval_T *rettv)
 	    /* vterm has finished, get the cell from scrollback */
 	    if (pos.col >= line->sb_cols)
 		break;
-	    cellattr = line->sb_cells + pos.col;
+	    cellattr = sb_line_cell(line, pos.col);
 	    width = cellattr->width;
 	    attrs = cellattr->attrs;
 	    fg = cellattr->fg;
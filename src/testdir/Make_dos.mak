@@ -102,9 +102,14 @@ nolog:
 	-if exist messages del messages
 
 benchmark:
-	bench_re_freeze.out
+	bench_re_freeze.out bench_sort_func.out bench_json.out bench_dict.out
 
 bench_re_freeze.out: bench_re_freeze.vim
+bench_sort_func.out: bench_sort_func.vim
+bench_json.out: bench_json.vim
+bench_dict.out: bench_dict.vim
+
+bench_re_freeze.out bench_sort_func.out bench_json.out bench_dict.out:
 	-if exist benchmark.out del benchmark.out
 	$(VIMPROG) -u dos.vim $(NO_INITS) $*.in
 	@IF EXIST benchmark.out ( type benchmark.out )
@@ -35,7 +35,8 @@ include Make_all.mak
 
 SCRIPTS = $(SCRIPTS_ALL) $(SCRIPTS_MORE1) $(SCRIPTS_MORE4) $(SCRIPTS_WIN32)
 
-SCRIPTS_BENCH = bench_re_freeze.out
+SCRIPTS_BENCH = bench_re_freeze.out bench_sort_func.out bench_json.out \
+		bench_dict.out
 
 # Must run test1 first to create small.vim.
 $(SCRIPTS) $(SCRIPTS_GUI) $(SCRIPTS_WIN32) $(NEW_TESTS): $(SCRIPTS_FIRST)
@@ -103,6 +104,11 @@ nolog:
 	-@if exist messages $(DEL) messages
 
 bench_re_freeze.out: bench_re_freeze.vim
+bench_sort_func.out: bench_sort_func.vim
+bench_json.out: bench_json.vim
+bench_dict.out: bench_dict.vim
+
+$(SCRIPTS_BENCH):
 	-$(DEL) benchmark.out
 	$(VIMPROG) -u dos.vim $(NO_INITS) $*.in
 	$(CAT) benchmark.out
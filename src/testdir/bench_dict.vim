@@ -0,0 +1,26 @@
+"Test for benchmarking adding and looking up Dictionary keys, which computes
+"the hash number of each key
+
+so small.vim
+if !has("reltime") | finish | endif
+func! Measure(count, rounds)
+	let names = ['a', 'i', 'idx', 'line', 'result', 'lnum',
+		\ 'current_buffer_name', 'foo_bar_baz', 'x', 'value']
+	let keys = map(range(a:count), 'names[v:val % 10] . (v:val / 10)')
+	let sstart = reltime()
+	let d = {}
+	for round in range(a:rounds)
+	  for k in keys
+	    let d[k] = round
+	  endfor
+	endfor
+	$put =printf('keys: %d, %d times, add: %s', a:count, a:rounds, reltimestr(reltime(sstart)))
+	let sstart = reltime()
+	let found = 0
+	for round in range(a:rounds)
+	  for k in keys
+	    let found += has_key(d, k)
+	  endfor
+	endfor
+	$put =printf('keys: %d, %d times, has_key(): %s', a:count, a:rounds, reltimestr(reltime(sstart)))
+endfunc
@@ -0,0 +1,38 @@
+"Test for benchmarking json_decode() and json_encode() with a large message
+
+so small.vim
+if !has("reltime") || !has("float") | finish | endif
+
+" A message that looks like what a language server sends: many objects with
+" file names, positions and messages, some with escapes and non-ASCII
+" characters.
+func! MakePayload(count)
+  let items = []
+  for i in range(a:count)
+    if i % 10 == 0
+      let msg = '"unused variable \"résumé\"\n\tdeclared here"'
+    elseif i % 10 == 1
+      let msg = "\"variable été is set but not used — remove it\""
+    else
+      let msg = '"unused variable ''result_of_the_computation'' in this function, consider removing it"'
+    endif
+    call add(items, printf('{"uri": "file:///home/user/projects/editor/src/module%d/source_file_%d.c", "range": {"start": {"line": %d, "character": 4}, "end": {"line": %d, "character": 27}}, "severity": %d, "source": "compiler", "code": "unused-variable", "message": %s, "tags": [1, 2]}', i % 37, i, i * 3, i * 3 + 1, i % 4 + 1, msg))
+  endfor
+  return '[0, {"jsonrpc": "2.0", "diagnostics": [' . join(items, ', ') . ']}]'
+endfunc
+
+func! Measure(count)
+  let payload = MakePayload(a:count)
+  let sstart = reltime()
+  for round in range(10)
+    let value = json_decode(payload)
+  endfor
+  let t = reltimefloat(reltime(sstart))
+  $put =printf('%d bytes, 10 times: json_decode() %.3f s (%.0f Mbyte/s)', len(payload), t, len(payload) * 10 / 1000000.0 / t)
+  let sstart = reltime()
+  for round in range(10)
+    let encoded = json_encode(value)
+  endfor
+  let t = reltimefloat(reltime(sstart))
+  $put =printf('%d bytes, 10 times: json_encode() %.3f s (%.0f Mbyte/s)', len(encoded), t, len(encoded) * 10 / 1000000.0 / t)
+endfunc
@@ -0,0 +1,17 @@
+"Test for benchmarking calling a user function for every compare in sort()
+
+so small.vim
+if !has("reltime") || !has("lambda") | finish | endif
+func! Compare(a, b)
+	return a:a == a:b ? 0 : a:a > a:b ? 1 : -1
+endfunc
+
+func! Measure(count)
+	let list = map(range(a:count), 'v:val * 7919 % a:count')
+	let sstart = reltime()
+	call sort(copy(list), 'Compare')
+	$put =printf('items: %d, function: %s', a:count, reltimestr(reltime(sstart)))
+	let sstart = reltime()
+	call sort(copy(list), {a, b -> a == b ? 0 : a > b ? 1 : -1})
+	$put =printf('items: %d, lambda: %s', a:count, reltimestr(reltime(sstart)))
+endfunc
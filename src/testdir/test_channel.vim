@@ -751,6 +751,27 @@ func Test_pipe_to_buffer_name_nomsg()
   call Run_test_pipe_to_buffer(1, 0, 1)
 endfunc
 
+" Many lines that arrive at once are appended to the buffer together.
+func Test_pipe_to_buffer_many_lines()
+  if !has('job')
+    return
+  endif
+  call ch_log('Test_pipe_to_buffer_many_lines()')
+  sp pipe-many-output
+  normal! G
+  let job = job_start([s:python, '-c', 'for i in range(20000): print(i)'],
+	\ {'out_io': 'buffer', 'out_name': 'pipe-many-output', 'out_msg': 0})
+  try
+    call WaitForAssert({-> assert_equal(20000, line('$'))})
+    call assert_equal(map(range(20000), 'string(v:val)'), getline(1, '$'))
+    " the cursor was on the last line and follows the output
+    call assert_equal(20000, line('.'))
+  finally
+    call job_stop(job)
+    bwipe!
+  endtry
+endfunc
+
 func Test_close_output_buffer()
   if !has('job')
     return
@@ -1823,3 +1844,237 @@ func Test_keep_pty_open()
   call assert_inrange(200, 1000, elapsed)
   call job_stop(job)
 endfunc
+
+" Messages that arrive in many pieces are received complete.
+func Test_long_messages()
+  call writefile([
+	\ 'import sys',
+	\ 'if sys.argv[1] == "nl":',
+	\ '    for i in range(3):',
+	\ '        sys.stdout.write("x" * 200000 + "\n")',
+	\ '        sys.stdout.flush()',
+	\ 'sys.stdout.write("[0, [" + ", ".join(["\"abc\""] * 50000) + "]]\n")',
+	\ ], 'Xlong.py')
+
+  let g:Ch_lens = []
+  let job = job_start(s:python . ' Xlong.py nl', {'mode': 'nl',
+	\ 'out_cb': {ch, msg -> add(g:Ch_lens, len(msg))}})
+  call WaitForAssert({-> assert_equal(4, len(g:Ch_lens))})
+  call assert_equal([200000, 200000, 200000, 350005], g:Ch_lens)
+
+  let g:Ch_lens = []
+  let job = job_start(s:python . ' Xlong.py json', {'mode': 'json',
+	\ 'out_cb': {ch, msg -> add(g:Ch_lens, len(msg))}})
+  call WaitForAssert({-> assert_equal([50000], g:Ch_lens)})
+
+  call delete('Xlong.py')
+endfunc
+
+" Values sent in msgpack mode come back unchanged.
+func Test_msgpack_pipe()
+  call writefile([
+	\ 'import struct, sys',
+	\ 'inp = getattr(sys.stdin, "buffer", sys.stdin)',
+	\ 'out = getattr(sys.stdout, "buffer", sys.stdout)',
+	\ 'def send(body):',
+	\ '    out.write(struct.pack(">I", len(body)) + body)',
+	\ '    out.flush()',
+	\ '# an extension type is dropped, the next message is received',
+	\ 'send(b"\x92\x00\xd4\x01\x02")',
+	\ 'send(b"\x92\x00\x81\xa1a\xcd\x01\x00")',
+	\ 'while True:',
+	\ '    head = inp.read(4)',
+	\ '    if len(head) < 4:',
+	\ '        break',
+	\ '    send(inp.read(struct.unpack(">I", head)[0]))',
+	\ ], 'Xmsgpack.py')
+
+  let g:Ch_msgs = []
+  let job = job_start(s:python . ' Xmsgpack.py', {'mode': 'msgpack',
+	\ 'callback': {ch, msg -> add(g:Ch_msgs, msg)}})
+  try
+    let handle = job_getchannel(job)
+    call assert_equal('MSGPACK', ch_info(handle).out_mode)
+    call WaitForAssert({-> assert_equal([{'a': 256}], g:Ch_msgs)})
+
+    for val in [0, 1, -1, 127, 128, -32, -33, 255, 65536, -70000,
+	  \ 0x7fffffff, -0x7fffffff, '', 'hello', "x\<NL>\"y\\",
+	  \ 'héllo €', repeat('s', 40), repeat('long', 20000),
+	  \ [], [1, 'two', [3]], range(20), {}, {'one': 1, '2': [{}]},
+	  \ v:true, v:false, v:null]
+      call assert_equal(val, ch_evalexpr(handle, val))
+    endfor
+    if has('num64')
+      call assert_equal(0x7fffffffffffffff, ch_evalexpr(handle, 0x7fffffffffffffff))
+      call assert_equal(-0x7fffffffffffffff, ch_evalexpr(handle, -0x7fffffffffffffff))
+    endif
+    if has('float')
+      call assert_equal(1.5, ch_evalexpr(handle, 1.5))
+      call assert_equal(-1.0e100, ch_evalexpr(handle, -1.0e100))
+    endif
+    call assert_equal(v:null, ch_evalexpr(handle, v:none))
+
+    call assert_fails("call ch_evalexpr(handle, function('tr'))", 'E474:')
+  finally
+    call job_stop(job)
+    call delete('Xmsgpack.py')
+    unlet g:Ch_msgs
+  endtry
+endfunc
+
+" In msgpack mode a message with a bad length, or one that is not completed
+" in time, is dropped, the messages after it are received.
+func Test_msgpack_bad_input()
+  call writefile([
+	\ 'import struct, sys, time',
+	\ 'out = getattr(sys.stdout, "buffer", sys.stdout)',
+	\ 'def send(body):',
+	\ '    out.write(body)',
+	\ '    out.flush()',
+	\ 'send(b"\xff\xff\xff\xff\x92\x00")',
+	\ 'time.sleep(0.3)',
+	\ 'send(b"\x00\x00\x00\x05\x92\x00\xa2ok")',
+	\ 'send(b"\x00\x00\x00\x0a\x92\x00\xa3")',
+	\ 'time.sleep(0.5)',
+	\ 'send(b"\x00\x00\x00\x05\x92\x00\xa2OK")',
+	\ 'send(b"\x00\x00\x00\x0a\x92")',
+	\ ], 'Xmsgpack.py')
+
+  let g:Ch_msgs = []
+  let job = job_start(s:python . ' Xmsgpack.py', {'mode': 'msgpack',
+	\ 'callback': {ch, msg -> add(g:Ch_msgs, msg)}})
+  try
+    let handle = job_getchannel(job)
+    call WaitForAssert({-> assert_equal(['ok', 'OK'], g:Ch_msgs)})
+    " The incomplete message at the end is dropped when the job exits.
+    call WaitForAssert({-> assert_equal('closed', ch_status(handle))})
+    call assert_equal(['ok', 'OK'], g:Ch_msgs)
+  finally
+    call job_stop(job)
+    call delete('Xmsgpack.py')
+    unlet g:Ch_msgs
+  endtry
+endfunc
+
+" Output of many jobs at the same time is received, also when file
+" descriptors are reused.
+func Test_many_jobs()
+  let g:Ch_count = 0
+  for round in range(2)
+    let jobs = []
+    for i in range(30)
+      call add(jobs, job_start(s:python . ' test_channel_pipe.py',
+	    \ {'out_cb': {ch, msg -> execute(msg == 'something'
+	    \			    ? 'let g:Ch_count += 1' : '')}}))
+    endfor
+    for job in jobs
+      call ch_sendraw(job, "echo something\n")
+    endfor
+    call WaitForAssert({-> assert_equal(30 * (round + 1), g:Ch_count)})
+    for job in jobs
+      call ch_sendraw(job, "quit\n")
+    endfor
+    for job in jobs
+      call WaitForAssert({-> assert_equal('dead', job_status(job))})
+    endfor
+  endfor
+  unlet g:Ch_count
+endfunc
+
+" Writing more than fits in the pipe does not block, the rest is queued and
+" written when the job reads it.
+func Test_write_queue()
+  if !has('unix')
+    return
+  endif
+  let g:Ch_drained = 0
+  let g:Ch_count = ''
+  let job = job_start(['sh', '-c', 'sleep 1; wc -c'], {
+	\ 'write_high': 100000,
+	\ 'write_low': 0,
+	\ 'drain_cb': {ch -> execute('let g:Ch_drained += 1')},
+	\ 'out_cb': {ch, msg -> execute('let g:Ch_count = msg')}})
+  try
+    call assert_equal(1, ch_canwrite(job))
+    call ch_sendraw(job, repeat(repeat('x', 999) . "\n", 1000))
+    call assert_true(ch_info(job_getchannel(job)).in_queued > 100000)
+    call assert_equal(0, ch_canwrite(job))
+
+    " closing is done when everything was written
+    call ch_close_in(job)
+    call WaitForAssert({-> assert_equal(1000000, str2nr(g:Ch_count))}, 10000)
+    call assert_equal(1, g:Ch_drained)
+    call assert_equal(0, ch_info(job_getchannel(job)).in_queued)
+  finally
+    call job_stop(job)
+    unlet g:Ch_drained
+    unlet g:Ch_count
+  endtry
+endfunc
+
+func Test_write_queue_options()
+  if !has('job')
+    return
+  endif
+  call assert_fails("call job_start('echo', {'write_high': -1})", 'E475:')
+  call assert_fails("call job_start('echo', {'write_low': -1})", 'E475:')
+endfunc
+
+" In JSON mode messages that were received but not decoded yet when the job
+" exits are not lost.
+func Test_json_readahead_after_close()
+  if !has('job')
+    return
+  endif
+  let g:Ch_msgs = []
+  let job = job_start([s:python, '-c',
+	\ 'import sys; sys.stdout.write("".join("[0,%d]\n" % i for i in range(2000)))'],
+	\ {'mode': 'json', 'callback': {ch, msg -> add(g:Ch_msgs, msg)}})
+  try
+    let handle = job_getchannel(job)
+    call WaitForAssert({-> assert_equal('closed', ch_status(handle))})
+    call assert_equal(range(2000), g:Ch_msgs)
+  finally
+    call job_stop(job)
+    unlet g:Ch_msgs
+  endtry
+endfunc
+
+func Test_batch_callback()
+  if !has('job')
+    return
+  endif
+  let g:Ch_msgs = []
+  let g:Ch_calls = 0
+  let job = job_start([s:python, '-c', 'for i in range(1000): print(i)'], {
+	\ 'batch': 300,
+	\ 'callback': {ch, msgs -> execute('let g:Ch_calls += 1 | call extend(g:Ch_msgs, msgs)')}})
+  try
+    call WaitForAssert({-> assert_equal(1000, len(g:Ch_msgs))})
+    call assert_equal(map(range(1000), 'string(v:val)'), g:Ch_msgs)
+    call assert_inrange(4, 999, g:Ch_calls)
+  finally
+    call job_stop(job)
+  endtry
+
+  " In JSON mode a message for a request ends the batch, it is dropped since
+  " there is no such request.
+  let g:Ch_msgs = []
+  let g:Ch_calls = 0
+  let job = job_start([s:python, '-c',
+	\ 'for i in range(100): print("[0,%d]" % i if i != 50 else "[7,50]")'], {
+	\ 'mode': 'json',
+	\ 'batch': 1000,
+	\ 'callback': {ch, msgs -> execute('let g:Ch_calls += 1 | call extend(g:Ch_msgs, msgs)')}})
+  try
+    call WaitForAssert({-> assert_equal(99, len(g:Ch_msgs))})
+    call assert_equal(range(50) + range(51, 99), g:Ch_msgs)
+    call assert_inrange(2, 99, g:Ch_calls)
+  finally
+    call job_stop(job)
+    unlet g:Ch_msgs
+    unlet g:Ch_calls
+  endtry
+
+  call assert_fails("call job_start('echo', {'batch': -1})", 'E475:')
+endfunc
@@ -1,5 +1,7 @@
 " Test for folding
 
+source screendump.vim
+
 func PrepIndent(arg)
   return [a:arg] + repeat(["\t".a:arg], 5)
 endfu
@@ -648,3 +650,26 @@ func Test_foldopen_exception()
   endtry
   call assert_match('E492:', a)
 endfunc
+
+" Closing a fold scrolls the text below it into place instead of drawing it
+" again, the result must be the same.
+func Test_fold_close_scroll_redraw()
+  if !CanRunVimInTerminal()
+    return
+  endif
+  call writefile([
+	\ 'call setline(1, map(range(1, 30), {i, v -> "line " . v}))',
+	\ '4,9fold',
+	\ '4,9foldopen',
+	\ 'redraw',
+	\ ], 'Xscript')
+  let buf = RunVimInTerminal('-S Xscript', {'rows': 12})
+  call term_sendkeys(buf, "4Gzc")
+  call VerifyScreenDump(buf, 'Test_fold_close_scroll_01', {})
+
+  call term_sendkeys(buf, "zo")
+  call VerifyScreenDump(buf, 'Test_fold_close_scroll_02', {})
+
+  call StopVimInTerminal(buf)
+  call delete('Xscript')
+endfunc
@@ -594,6 +594,31 @@ func Test_matchstrpos()
   call assert_equal(['', -1, -1, -1], matchstrpos(['vim', 'testing', 'execute'], 'img'))
 endfunc
 
+func Test_matchbufline()
+  new
+  call setline(1, ['tik tok', '', 'acd', 'x'])
+  let buf = bufnr('')
+  call assert_equal([{'lnum': 1, 'byteidx': 0, 'text': 'tik'},
+	\ {'lnum': 1, 'byteidx': 4, 'text': 'tok'},
+	\ {'lnum': 3, 'byteidx': 0, 'text': 'acd'}],
+	\ matchbufline(buf, '\<[a-w]\+\>', 1, '$'))
+  call assert_equal([{'lnum': 3, 'byteidx': 0, 'text': 'acd',
+	\ 'submatches': ['a', '', 'c', 'd', '', '', '', '', '']}],
+	\ matchbufline(buf, '\(a\)\?\(b\)\?\(c\)\?\(.*\)', 3, 3,
+	\ {'submatches': v:true}))
+  call assert_equal([], matchbufline(buf, 'nothere', 1, 4))
+  " empty matches don't get stuck
+  call assert_equal([0, 1, 2, 3], map(matchbufline(buf, 'y*', 3, 3),
+	\ 'v:val.byteidx'))
+
+  call assert_fails('call matchbufline(buf, "x", 0, 1)', 'E16:')
+  call assert_fails('call matchbufline(buf, "x", 2, 1)', 'E16:')
+  call assert_fails('call matchbufline(buf, "x", 1, 5)', 'E16:')
+  call assert_fails('call matchbufline(buf, "x", 1, 1, 1)', 'E715:')
+  call assert_fails('call matchbufline(9999, "x", 1, 1)', 'E475:')
+  bwipe!
+endfunc
+
 func Test_nextnonblank_prevnonblank()
   new
 insert
@@ -51,3 +51,81 @@ func Test_hlsearch_hangs()
   set nohlsearch redrawtime&
   bwipe!
 endfunc
+
+func Test_hlsearch_after_change()
+  new
+  call setline(1, ['foo', 'bar', 'foo bar', 'baz'])
+  set hlsearch nolazyredraw
+  let @/ = 'bar'
+  redraw
+  let attr = screenattr(2, 1)
+  call assert_notequal(attr, screenattr(1, 1))
+  call assert_equal(attr, screenattr(3, 5))
+
+  " Changing, inserting and deleting lines updates the highlighting.
+  call setline(2, 'xxx')
+  redraw
+  call assert_notequal(attr, screenattr(2, 1))
+  call setline(1, 'bar')
+  redraw
+  call assert_equal(attr, screenattr(1, 1))
+  call append(0, 'zzz-bar')
+  redraw
+  call assert_notequal(attr, screenattr(1, 1))
+  call assert_equal(attr, screenattr(1, 5))
+  call assert_equal(attr, screenattr(2, 1))
+  call assert_notequal(attr, screenattr(3, 1))
+  call assert_equal(attr, screenattr(4, 5))
+  " Start a new undo block, so that "undo" only restores these lines.
+  let &undolevels = &undolevels
+  2,3d
+  redraw
+  call assert_equal(attr, screenattr(2, 5))
+  call assert_notequal(attr, screenattr(3, 1))
+  undo
+  redraw
+  call assert_equal(attr, screenattr(2, 1))
+  call assert_notequal(attr, screenattr(3, 1))
+
+  " Changing 'ignorecase' and 'iskeyword' is noticed.
+  let @/ = '\<BAR\>'
+  redraw
+  call assert_notequal(attr, screenattr(2, 1))
+  set ignorecase
+  redraw
+  call assert_equal(attr, screenattr(2, 1))
+  setlocal iskeyword+=45
+  redraw!
+  call assert_equal(attr, screenattr(2, 1))
+  call assert_notequal(attr, screenattr(1, 5))
+  setlocal iskeyword&
+  redraw!
+  call assert_equal(attr, screenattr(1, 5))
+
+  set nohlsearch noignorecase
+  bwipe!
+endfunc
+
+func Test_hlsearch_tilde()
+  new
+  call setline(1, ['foo', 'bar', 'baz'])
+  set hlsearch nolazyredraw
+  " "~" in the pattern stands for the last substitute string.
+  3s/baz/foo/e
+  call setline(3, 'baz')
+  let @/ = '~'
+  redraw!
+  let attr = screenattr(1, 1)
+  call assert_notequal(attr, screenattr(2, 1))
+
+  " The pattern text stays the same, but "~" now matches "bar".
+  3s/baz/bar/e
+  call setline(3, 'baz')
+  let @/ = '~'
+  redraw!
+  call assert_notequal(attr, screenattr(1, 1))
+  call assert_equal(attr, screenattr(2, 1))
+
+  set nohlsearch
+  bwipe!
+endfunc
@@ -25,3 +25,38 @@ func Test_let()
   let s = "\na                     #1\nb                     #2"
   call assert_equal(s, out)
 endfunc
+
+func Test_let_append_string()
+  let s = 'a'
+  for i in range(5)
+    let s .= i
+  endfor
+  let s .= 'b' . s . 'c'
+  call assert_equal('a01234ba01234c', s)
+  let s .= ''
+  call assert_equal('a01234ba01234c', s)
+
+  let d = {'k': 'x'}
+  let d.k .= 'y'
+  let l = ['p']
+  let l[0] .= 'q' . 7
+  call assert_equal(['xy', 'pq7'], [d.k, l[0]])
+
+  let n = 5
+  let n .= 6
+  call assert_equal('56', n)
+
+  let v:errmsg = 'err'
+  let v:errmsg .= 'msg'
+  call assert_equal('errmsg', v:errmsg)
+
+  let s = 'abc'
+  call assert_fails('let s .= [1]', 'E734:')
+  call assert_fails('let s .= {}', 'E734:')
+  call assert_equal('abc', s)
+  lockvar s
+  call assert_fails('let s .= "x"', 'E741:')
+  unlockvar s
+  call assert_equal('abc', s)
+  call assert_fails('let v:version .= "x"', 'E46:')
+endfunc
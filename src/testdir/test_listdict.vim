@@ -601,3 +601,68 @@ func Test_listdict_extend()
   call assert_fails("call extend(d, d, 'error')", 'E737:')
   call assert_equal({'a': {'b': 'B'}}, d)
 endfunc
+
+" Get item "n" of List "l" without indexing.
+func s:Nth(l, n)
+  let i = 0
+  for item in a:l
+    if i == a:n
+      return item
+    endif
+    let i += 1
+  endfor
+endfunc
+
+" Indexing a long List while it is changed in various ways.
+func Test_list_index_after_change()
+  let l = range(100)
+  call assert_equal(70, l[70])
+  call insert(l, 'a', 50)
+  call assert_equal(s:Nth(l, 70), l[70])
+  call remove(l, 10)
+  call assert_equal(s:Nth(l, 80), l[80])
+  call remove(l, -1)
+  call assert_equal(98, l[-1])
+  call add(l, 'b')
+  call assert_equal('b', l[99])
+  call extend(l, ['c', 'd'], 20)
+  call assert_equal(s:Nth(l, 30), l[30])
+  unlet l[5:8]
+  call assert_equal(s:Nth(l, 40), l[40])
+  call reverse(l)
+  call assert_equal(s:Nth(l, 3), l[3])
+  call sort(l)
+  call assert_equal(s:Nth(l, 91), l[91])
+  let l = repeat([1, 1, 2], 30)
+  call assert_equal(2, l[65])
+  call uniq(l)
+  call assert_equal(repeat([1, 2], 30), l)
+  call assert_equal(2, l[59])
+  call insert(l, 3)
+  call assert_equal(3, l[0])
+  call assert_equal(1, l[59])
+  call assert_equal([1, 2], remove(l, 59, 60))
+  call assert_equal(59, len(l))
+  call assert_equal(1, l[57])
+endfunc
+
+" Garbage collection statistics
+func Test_garbagecollect_info()
+  let l = [1]
+  let d = {'l': l}
+  let l[0] = d
+  unlet l d
+  let before = garbagecollect_info()
+  call test_garbagecollect_now()
+  let info = garbagecollect_info()
+  call assert_equal(before.count + 1, info.count)
+  call assert_equal(2, info.freed)
+  call assert_equal(before.total_freed + 2, info.total_freed)
+  call assert_true(info.marked > 0)
+  call assert_true(info.skipped >= 0)
+  if has('reltime') && has('float')
+    call assert_equal(v:t_float, type(info.time))
+    call assert_true(info.max_time >= info.time)
+    call assert_true(info.total_time >= info.time)
+  endif
+endfunc
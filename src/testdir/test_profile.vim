@@ -170,7 +170,7 @@ endfunc
 
 func Test_profile_completion()
   call feedkeys(":profile \<C-A>\<C-B>\"\<CR>", 'tx')
-  call assert_equal('"profile continue file func pause start', @:)
+  call assert_equal('"profile continue file func pause sample start', @:)
 
   call feedkeys(":profile start test_prof\<C-A>\<C-B>\"\<CR>", 'tx')
   call assert_match('^"profile start.* test_profile\.vim', @:)
@@ -182,6 +182,51 @@ func Test_profile_errors()
   call assert_fails("profile continue", 'E750:')
 endfunc
 
+func Test_profile_sample()
+  if !has('unix')
+    return
+  endif
+  let lines = [
+    \ 'func! Inner()',
+    \ '  let l:count = 0',
+    \ '  for i in range(1000)',
+    \ '    let l:count += i',
+    \ '  endfor',
+    \ 'endfunc',
+    \ 'func! Outer()',
+    \ '  let start = reltime()',
+    \ '  while reltimefloat(reltime(start)) < 0.3',
+    \ '    call Inner()',
+    \ '  endwhile',
+    \ 'endfunc',
+    \ 'call Outer()',
+    \ "call system('true')",
+    \ 'call Outer()',
+    \ ]
+
+  call writefile(lines, 'Xprofile_sample.vim')
+  call system(v:progpath
+    \ . ' -es -u NONE -U NONE -i NONE --noplugin'
+    \ . ' -c "profile sample Xprofile_sample.log"'
+    \ . ' -c "so Xprofile_sample.vim"'
+    \ . ' -c "profile sample stop"'
+    \ . ' -c "qall!"')
+  call assert_equal(0, v:shell_error)
+
+  " Each line is a folded stack with the number of samples.
+  let lines = readfile('Xprofile_sample.log')
+  call assert_notequal([], lines)
+  for line in lines
+    call assert_match('^\S.* \d\+$', line)
+  endfor
+  " The number of samples depends on timing, only check that Inner() called
+  " from Outer() was seen.
+  call assert_notequal([], filter(copy(lines), 'v:val =~ "^Outer:\\d\\+;Inner:\\d\\+ "'))
+
+  call delete('Xprofile_sample.vim')
+  call delete('Xprofile_sample.log')
+endfunc
+
 func Test_profile_truncate_mbyte()
   if !has('multi_byte') || &enc !=# 'utf-8'
     return
@@ -771,3 +771,40 @@ func Test_search_sentence()
   /\%'(
   /
 endfunc
+
+func Test_searchcount()
+  new
+  call setline(1, ['one two three', 'two', 'three two', 'xxx'])
+  let @/ = 'two'
+  call cursor(1, 1)
+  call assert_equal({'current': 0, 'total': 3, 'exact_match': 0,
+	\ 'incomplete': 0}, searchcount())
+  call cursor(1, 5)
+  call assert_equal({'current': 1, 'total': 3, 'exact_match': 1,
+	\ 'incomplete': 0}, searchcount())
+  call cursor(3, 1)
+  call assert_equal({'current': 2, 'total': 3, 'exact_match': 0,
+	\ 'incomplete': 0}, searchcount())
+  call assert_equal({'current': 3, 'total': 3, 'exact_match': 1,
+	\ 'incomplete': 0}, searchcount({'pos': [3, 7]}))
+
+  " the count is updated after a change
+  call setline(4, 'two two')
+  call assert_equal(5, searchcount().total)
+  call assert_equal(2, searchcount({'pattern': 'three'}).total)
+
+  " empty matches are counted like with :s//gn
+  for pat in ['x*', 'o*', '\<', 'e\zs', 'o\n', '\n\zst', '^', '$']
+    let n = matchstr(execute('keeppatterns %s/' . pat . '//gn'), '\d\+')
+    call assert_equal(str2nr(n), searchcount({'pattern': pat}).total, pat)
+  endfor
+
+  let result = searchcount({'maxcount': 2, 'pos': [4, 1]})
+  call assert_equal(2, result.total)
+  call assert_equal(2, result.incomplete)
+  call assert_equal(0, result.current)
+
+  call assert_fails("call searchcount('two')", 'E715:')
+  call assert_fails("call searchcount({'pos': 'x'})", 'E475:')
+  bwipe!
+endfunc
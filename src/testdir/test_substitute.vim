@@ -116,6 +116,24 @@ func Test_substitute_repeat()
 endfunc
 
 " Test for *sub-replace-special* and *sub-replace-expression* on substitute().
+func Test_substitute_list()
+  call assert_equal(['aBc', 'xBx', '12', ''],
+	\ substitute(['abc', 'xbx', 12, ''], 'b', 'B', 'g'))
+  call assert_equal(['aXbb', 'X'], substitute(['abbb', 'b'], 'b', 'X', ''))
+  call assert_equal(['aB!c', 'B!B!'],
+	\ substitute(['abc', 'bb'], 'b', {m -> toupper(m[0]) . '!'}, 'g'))
+  call assert_equal(['a-c'],
+	\ substitute(['abc'], 'b', '\=submatch(0) == "b" ? "-" : "?"', ''))
+  call assert_equal([], substitute([], 'b', 'B', 'g'))
+
+  " the input list is not changed
+  let l = ['abc']
+  call assert_equal(['aBc'], substitute(l, 'b', 'B', ''))
+  call assert_equal(['abc'], l)
+
+  call assert_fails("call substitute([[1]], 'b', 'B', '')", 'E730:')
+endfunc
+
 func Test_sub_replace_1()
   " Run the tests with 'magic' on
   set magic
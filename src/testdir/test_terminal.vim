@@ -290,6 +290,39 @@ func Test_terminal_scrollback()
   set termwinscroll&
 endfunc
 
+func Test_terminal_scrollback_attr()
+  if !has('unix')
+    return
+  endif
+  call writefile(["\<Esc>[31mred\<Esc>[0m plain\<Esc>[32mgreen\<Esc>[0m"]
+	\ + range(20), 'Xtext')
+  let buf = term_start('cat Xtext', {'term_rows': 5})
+  let job = term_getjob(buf)
+  call WaitForAssert({-> assert_equal("dead", job_status(job))})
+  call term_wait(buf)
+
+  " The first line has scrolled off the terminal, rows before it are zero or
+  " negative.
+  call assert_equal('red plaingreen', getline(1))
+  let row = 0
+  while row > -30 && term_getline(buf, row) != 'red plaingreen'
+    let row -= 1
+  endwhile
+  call assert_true(row > -30)
+  let l = term_scrape(buf, row)
+  call assert_equal(14, len(l))
+  call assert_equal('r', l[0].chars)
+  call assert_equal(l[0].fg, l[2].fg)
+  call assert_notequal(l[0].fg, l[3].fg)
+  call assert_equal(l[3].fg, l[8].fg)
+  call assert_notequal(l[8].fg, l[9].fg)
+  call assert_notequal(l[0].fg, l[9].fg)
+  call assert_equal(l[9].fg, l[13].fg)
+
+  exe buf . 'bwipe'
+  call delete('Xtext')
+endfunc
+
 func Test_terminal_size()
   let cmd = Get_cat_123_cmd()
 
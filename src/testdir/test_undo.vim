@@ -410,3 +410,60 @@ func Test_redo_empty_line()
   exe "norm."
   bwipe!
 endfunc
+
+func Test_undo_substitute_many_lines()
+  new
+  let lines = map(range(1, 20), '"a" . v:val . "a"')
+  call setline(1, lines)
+  let &undolevels = &undolevels
+  " Changes lines one by one, including the last one.
+  %s/a/b/g
+  call assert_equal('b20b', getline('$'))
+  undo
+  call assert_equal(lines, getline(1, '$'))
+  redo
+  call assert_equal(map(copy(lines), 'substitute(v:val, "a", "b", "g")'),
+	\ getline(1, '$'))
+  undo
+
+  " Not all lines changed, then a line is deleted.
+  let &undolevels = &undolevels
+  g/[13579]a$/s/a/c/
+  $delete
+  5,6s/a/d/
+  call assert_equal(19, line('$'))
+  call assert_equal(['c1a', 'a2a', 'c3a', 'a4a', 'c5d', 'd6a'], getline(1, 6))
+  undo
+  call assert_equal(lines, getline(1, '$'))
+  bwipe!
+endfunc
+
+" ":%s" saves the changed lines in one undo entry, the undo file is then as
+" big as for an operator that saves all the lines at once.
+func Test_undo_substitute_one_entry()
+  if !has('persistent_undo')
+    return
+  endif
+  let lines = map(range(1, 20), '"a" . v:val . "a"')
+  new
+  call setline(1, lines)
+  let &undolevels = &undolevels
+  normal! ggVGgU
+  wundo Xundofile
+  let size = getfsize('Xundofile')
+  bwipe!
+
+  new
+  call setline(1, lines)
+  let &undolevels = &undolevels
+  %s/a/A/g
+  call assert_equal('A20A', getline('$'))
+  wundo Xundofile
+  call assert_equal(size, getfsize('Xundofile'))
+  undo
+  call assert_equal(lines, getline(1, '$'))
+  redo
+  call assert_equal(map(copy(lines), 'toupper(v:val)'), getline(1, '$'))
+  bwipe!
+  call delete('Xundofile')
+endfunc
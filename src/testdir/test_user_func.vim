@@ -94,3 +94,52 @@ func Test_user_func()
   unlet g:retval g:counter
   enew!
 endfunc
+
+func s:LocalVars(x)
+  let res = []
+  for i in range(3)
+    let v = i * 10
+    let tv = a:x
+    call add(res, v + tv)
+    unlet v
+    if i == 1
+      call remove(l:, 'tv')
+      let tv = 100
+      call add(res, tv)
+    endif
+    call add(res, exists('v'))
+  endfor
+  let l:count = 5
+  call add(res, count)
+  return res
+endfunc
+
+" Local variables are found correctly after being removed and added.
+func Test_user_func_local_vars()
+  call assert_equal([1, 0, 11, 100, 0, 21, 0, v:count], s:LocalVars(1))
+endfunc
+
+func s:ArgVars(a, ...) range
+  let g:res = [a:0, a:000, a:firstline, a:lastline, exists('a:000')]
+  call add(g:res, sort(keys(a:)))
+  call assert_fails('let a:0 = 3', 'E46:')
+  call assert_fails('unlet a:firstline', 'E795:')
+endfunc
+
+func s:ArgDict(...)
+  return a:
+endfunc
+
+" a:0, a:000, a:firstline and a:lastline are added when used.
+func Test_user_func_arg_vars()
+  new
+  call setline(1, range(5))
+  2,3call s:ArgVars(1, 'x')
+  call assert_equal([1, ['x'], 2, 3, 1,
+	\ ['0', '000', '1', 'a', 'firstline', 'lastline']], g:res)
+  call assert_equal(2, s:ArgDict(5, 6)['0'])
+  call assert_equal([5, 6], s:ArgDict(5, 6)['000'])
+  call assert_equal(line('.'), s:ArgDict()['firstline'])
+  unlet g:res
+  bwipe!
+endfunc
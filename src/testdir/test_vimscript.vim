@@ -1441,6 +1441,37 @@ func Test_script_local_func()
   enew! | close
 endfunc
 
+" Test that lines in a loop are executed the same way every time, also when
+" the parsed command is reused.
+func Test_loop_lines_repeated()
+  new
+  call setline(1, ['a', 'b', 'c'])
+  let l = []
+  let i = 0
+  while i < 3
+    let i += 1
+    silent 1,2s/$/x/
+    call add(l, getline(1)) | if i == 2 | call add(l, 'two') | endif
+    $put ='z'
+    :$d
+    exe 'call add(l, i)'
+  endwhile
+  call assert_equal(['ax', 1, 'axx', 'two', 2, 'axxx', 3], l)
+  call assert_equal(['axxx', 'bxxx', 'c'], getline(1, '$'))
+
+  let l = []
+  for n in range(4)
+    if n % 2
+      call add(l, n)
+    else
+      call add(l, -n)
+    endif
+    keepjumps call add(l, 'k')
+  endfor
+  call assert_equal([0, 'k', 1, 'k', -2, 'k', 3, 'k'], l)
+  bwipe!
+endfunc
+
 "-------------------------------------------------------------------------------
 " Modelines								    {{{1
 " vim: ts=8 sw=4 tw=80 fdm=marker
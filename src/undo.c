@@ -637,6 +637,58 @@ u_savecommon(
 		prev_uep = uep;
 		uep = uep->ue_next;
 	    }
+
+	    /*
+	     * When saving the line just below the lines saved by the last
+	     * entry, and the line count didn't change, add the line to that
+	     * entry.  Avoids one entry per line for commands that change many
+	     * lines one by one, such as ":%s".  When "newbot" is given, as
+	     * with u_savesub(), the line must be replaced by one line and the
+	     * last entry must end just above it.
+	     */
+	    uep = u_get_headentry();
+	    if (uep != NULL && uep->ue_size > 0
+		    && top == uep->ue_top + uep->ue_size
+		    && (newbot == 0
+			? (curbuf->b_u_newhead->uh_getbot_entry == uep
+			    && uep->ue_lcount == curbuf->b_ml.ml_line_count)
+			: (newbot == top + 2
+			    && curbuf->b_u_newhead->uh_getbot_entry != uep
+			    && uep->ue_bot == top + 1)))
+	    {
+		char_u	*line;
+
+		line = u_save_line(top + 1);
+		if (line == NULL)
+		    goto nomem;
+		if (uep->ue_size == uep->ue_maxsize)
+		{
+		    char_u  **array;
+		    long    maxsize = uep->ue_maxsize * 2;
+
+		    /* Double the size, u_getbot() shrinks it when done. */
+		    array = (char_u **)vim_realloc(uep->ue_array,
+					       sizeof(char_u *) * maxsize);
+		    if (array == NULL)
+		    {
+			vim_free(line);
+			goto nomem;
+		    }
+		    uep->ue_array = array;
+		    uep->ue_maxsize = maxsize;
+		}
+		uep->ue_array[uep->ue_size++] = line;
+		if (newbot != 0)
+		    uep->ue_bot = newbot;
+		else if (bot > curbuf->b_ml.ml_line_count)
+		{
+		    uep->ue_bot = 0;
+		    curbuf->b_u_newhead->uh_getbot_entry = NULL;
+		}
+		curbuf->b_u_synced = FALSE;
+		undo_undoes = FALSE;
+		return OK;
+	    }
 	}
 
 	/* find line number for ue_bot for previous u_save() */
@@ -664,6 +716,7 @@ u_savecommon(
 #endif
 
     uep->ue_size = size;
+    uep->ue_maxsize = size;
     uep->ue_top = top;
     if (newbot != 0)
 	uep->ue_bot = newbot;
@@ -1406,6 +1459,7 @@ unserialize_uep(bufinfo_T *bi, int *error, char_u *file_name)
     uep->ue_bot = undo_read_4c(bi);
     uep->ue_lcount = undo_read_4c(bi);
     uep->ue_size = undo_read_4c(bi);
+    uep->ue_maxsize = uep->ue_size;
     if (uep->ue_size > 0)
     {
 	if (uep->ue_size < LONG_MAX / (int)sizeof(char_u *))
@@ -2780,6 +2834,7 @@ u_undoredo(int undo)
 	u_newcount += newsize;
 	u_oldcount += oldsize;
 	uep->ue_size = oldsize;
+	uep->ue_maxsize = oldsize;
 	uep->ue_array = newarray;
 	uep->ue_bot = top + newsize + 1;
 
@@ -3261,6 +3316,19 @@ u_getbot(void)
     if (uep == NULL)
 	return;
 
+    /* Lines are no longer added to the last entry, free unused space. */
+    if (uep->ue_maxsize > uep->ue_size)
+    {
+	char_u **array = (char_u **)vim_realloc(uep->ue_array,
+					       sizeof(char_u *) * uep->ue_size);
+
+	if (array != NULL)
+	{
+	    uep->ue_array = array;
+	    uep->ue_maxsize = uep->ue_size;
+	}
+    }
+
     uep = curbuf->b_u_newhead->uh_getbot_entry;
     if (uep != NULL)
     {
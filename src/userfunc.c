@@ -45,6 +45,12 @@ funccall_T *current_funccal = NULL;
  * item in it is still being used. */
 funccall_T *previous_funccal = NULL;
 
+/* A funccall_T is quite big, allocating and freeing one for every function
+ * call is slow.  Keep a few freed ones here to be used again. */
+#define FC_POOL_SIZE 16
+static funccall_T *funccal_pool[FC_POOL_SIZE];
+static int funccal_pool_len = 0;
+
 static char *e_funcexts = N_("E122: Function %s already exists, add ! to replace it");
 static char *e_funcdict = N_("E717: Dictionary entry already exists");
 static char *e_funcref = N_("E718: Funcref required");
@@ -66,6 +72,7 @@ static int
 	prof_self_cmp(const void *s1, const void *s2);
 #endif
 static void funccal_unref(funccall_T *fc, ufunc_T *fp, int force);
+static void add_lazy_args(funccall_T *fc);
 
     void
 func_init()
@@ -185,6 +192,8 @@ register_closure(ufunc_T *fp)
     funccal_unref(fp->uf_scoped, fp, FALSE);
     fp->uf_scoped = current_funccal;
     current_funccal->fc_refcount++;
+    /* The closure may use the a: variables after the function returned. */
+    add_lazy_args(current_funccal);
 
     if (ga_grow(&current_funccal->fc_funcs, 1) == FAIL)
 	return FAIL;
@@ -570,23 +579,65 @@ cat_func_name(char_u *buf, ufunc_T *fp)
 }
 
 /*
- * Add a number variable "name" to dict "dp" with value "nr".
+ * Set "v" to a number variable "name" with value "nr".
  */
     static void
-add_nr_var(
-    dict_T	*dp,
+set_nr_var(
     dictitem_T	*v,
     char	*name,
     varnumber_T nr)
 {
     STRCPY(v->di_key, name);
     v->di_flags = DI_FLAGS_RO | DI_FLAGS_FIX;
-    hash_add(&dp->dv_hashtab, DI2HIKEY(v));
     v->di_tv.v_type = VAR_NUMBER;
     v->di_tv.v_lock = VAR_FIXED;
     v->di_tv.vval.v_number = nr;
 }
 
+/*
+ * Add a:0, a:000, a:firstline and a:lastline to the a: variables of "fc", if
+ * this wasn't done yet.
+ */
+    static void
+add_lazy_args(funccall_T *fc)
+{
+    int		i;
+
+    if (fc->fc_lazy_args < 0)
+	return;
+    for (i = fc->fc_lazy_args; i < fc->fc_lazy_args + 4; ++i)
+	hash_add(&fc->l_avars.dv_hashtab, DI2HIKEY(&fc->fixvar[i].var));
+    fc->fc_lazy_args = -1;
+}
+
+/*
+ * Called when "varname" was not found in hashtab "ht".  When "ht" holds the
+ * a: variables of a function being executed and "varname" is one of the
+ * variables added by add_lazy_args(), add them.
+ * Returns TRUE when variables were added, "varname" must be looked up again.
+ */
+    int
+add_lazy_args_ht(hashtab_T *ht, char_u *varname)
+{
+    funccall_T	*fc;
+
+    if (!((varname[0] == '0' && (varname[1] == NUL
+					     || STRCMP(varname, "000") == 0))
+		|| STRCMP(varname, "firstline") == 0
+		|| STRCMP(varname, "lastline") == 0))
+	return FALSE;
+
+    for (fc = current_funccal; fc != NULL; fc = fc->caller)
+	if (ht == &fc->l_avars.dv_hashtab)
+	{
+	    if (fc->fc_lazy_args < 0)
+		return FALSE;
+	    add_lazy_args(fc);
+	    return TRUE;
+	}
+    return FALSE;
+}
+
 /*
  * Free "fc" and what it contains.
  */
@@ -624,7 +675,10 @@ free_funccal(
 	    clear_tv(&li->li_tv);
 
     func_ptr_unref(fc->func);
-    vim_free(fc);
+    if (funccal_pool_len < FC_POOL_SIZE)
+	funccal_pool[funccal_pool_len++] = fc;
+    else
+	vim_free(fc);
 }
 
 /*
@@ -655,8 +709,10 @@ cleanup_function_call(funccall_T *fc)
 	/* "fc" is still in use.  This can happen when returning "a:000",
 	 * assigning "l:" to a global variable or defining a closure.
 	 * Link "fc" in the list for garbage collection later. */
+	add_lazy_args(fc);
 	fc->caller = previous_funccal;
 	previous_funccal = fc;
+	may_have_garbage = TRUE;
 
 	/* Make a copy of the a: variables, since we didn't do that above. */
 	todo = (int)fc->l_avars.dv_hashtab.ht_used;
@@ -720,7 +776,10 @@ call_user_func(
 
     line_breakcheck();		/* check for CTRL-C hit */
 
-    fc = (funccall_T *)alloc(sizeof(funccall_T));
+    if (funccal_pool_len > 0)
+	fc = funccal_pool[--funccal_pool_len];
+    else
+	fc = (funccall_T *)alloc(sizeof(funccall_T));
     fc->caller = current_funccal;
     current_funccal = fc;
     fc->func = fp;
@@ -769,9 +828,13 @@ call_user_func(
      * Init a: variables.
      * Set a:0 to "argcount".
      * Set a:000 to a list with room for the "..." arguments.
+     * Set a:firstline to "firstline" and a:lastline to "lastline".
+     * Most functions never use these, they are only added to the hashtab
+     * when needed, see add_lazy_args().
      */
     init_var_dict(&fc->l_avars, &fc->l_avars_var, VAR_SCOPE);
-    add_nr_var(&fc->l_avars, &fc->fixvar[fixvar_idx++].var, "0",
+    fc->fc_lazy_args = fixvar_idx;
+    set_nr_var(&fc->fixvar[fixvar_idx++].var, "0",
 				(varnumber_T)(argcount - fp->uf_args.ga_len));
     /* Use "name" to avoid a warning from some compiler that checks the
      * destination size. */
@@ -779,23 +842,21 @@ call_user_func(
     name = v->di_key;
     STRCPY(name, "000");
     v->di_flags = DI_FLAGS_RO | DI_FLAGS_FIX;
-    hash_add(&fc->l_avars.dv_hashtab, DI2HIKEY(v));
     v->di_tv.v_type = VAR_LIST;
     v->di_tv.v_lock = VAR_FIXED;
     v->di_tv.vval.v_list = &fc->l_varlist;
     vim_memset(&fc->l_varlist, 0, sizeof(list_T));
     fc->l_varlist.lv_refcount = DO_NOT_FREE_CNT;
     fc->l_varlist.lv_lock = VAR_FIXED;
+    set_nr_var(&fc->fixvar[fixvar_idx++].var, "firstline",
+						      (varnumber_T)firstline);
+    set_nr_var(&fc->fixvar[fixvar_idx++].var, "lastline",
+						       (varnumber_T)lastline);
 
     /*
-     * Set a:firstline to "firstline" and a:lastline to "lastline".
      * Set a:name to named arguments.
      * Set a:N to the "..." arguments.
      */
-    add_nr_var(&fc->l_avars, &fc->fixvar[fixvar_idx++].var, "firstline",
-						      (varnumber_T)firstline);
-    add_nr_var(&fc->l_avars, &fc->fixvar[fixvar_idx++].var, "lastline",
-						       (varnumber_T)lastline);
     for (i = 0; i < argcount; ++i)
     {
 	int	    addlocal = FALSE;
@@ -1016,6 +1077,9 @@ call_user_func(
 #ifdef FEAT_PROFILE
     if (do_profiling == PROF_YES)
 	script_prof_restore(&wait_start);
+# ifdef HAVE_PROF_SAMPLE
+    prof_sample_set_pos();
+# endif
 #endif
 
     if (p_verbose >= 12 && sourcing_name != NULL)
@@ -1063,6 +1127,7 @@ funccal_unref(funccall_T *fc, ufunc_T *fp, int force)
 		return;
 	    }
 	}
+    may_have_garbage = TRUE;
     for (i = 0; i < fc->fc_funcs.ga_len; ++i)
 	if (((ufunc_T **)(fc->fc_funcs.ga_data))[i] == fp)
 	    ((ufunc_T **)(fc->fc_funcs.ga_data))[i] = NULL;
@@ -1101,6 +1166,7 @@ func_clear(ufunc_T *fp, int force)
     /* clear this function */
     ga_clear_strings(&(fp->uf_args));
     ga_clear_strings(&(fp->uf_lines));
+    vim_free(fp->uf_parsed);
 #ifdef FEAT_PROFILE
     vim_free(fp->uf_tml_count);
     vim_free(fp->uf_tml_total);
@@ -1219,6 +1285,9 @@ free_all_functions(void)
     }
     if (skipped == 0)
 	hash_clear(&func_hashtab);
+
+    while (funccal_pool_len > 0)
+	vim_free(funccal_pool[--funccal_pool_len]);
 }
 #endif
 
@@ -2290,6 +2359,7 @@ ex_function(exarg_T *eap)
 		/* redefine existing function */
 		ga_clear_strings(&(fp->uf_args));
 		ga_clear_strings(&(fp->uf_lines));
+		VIM_CLEAR(fp->uf_parsed);
 		VIM_CLEAR(name);
 	    }
 	}
@@ -3307,6 +3377,30 @@ get_func_line(
     return retval;
 }
 
+/*
+ * Get the parsed command for the line last returned by get_func_line().
+ * Called by do_cmdline() to avoid parsing the same line again every time it
+ * is executed.
+ * Returns NULL when out of memory.
+ */
+    cmdparse_T *
+func_line_parsed(void *cookie)
+{
+    funccall_T	*fcp = (funccall_T *)cookie;
+    ufunc_T	*fp = fcp->func;
+
+    if (fcp->linenr < 1 || fcp->linenr > fp->uf_lines.ga_len)
+	return NULL;
+    if (fp->uf_parsed == NULL)
+    {
+	fp->uf_parsed = (cmdparse_T *)alloc_clear(
+		      (unsigned)(sizeof(cmdparse_T) * fp->uf_lines.ga_len));
+	if (fp->uf_parsed == NULL)
+	    return NULL;
+    }
+    return &fp->uf_parsed[fcp->linenr - 1];
+}
+
 #if defined(FEAT_PROFILE) || defined(PROTO)
 /*
  * Called when starting to read a function line.
@@ -3647,9 +3741,14 @@ get_funccal_args_ht()
     dictitem_T *
 get_funccal_args_var()
 {
+    funccall_T	*fc;
+
     if (current_funccal == NULL)
 	return NULL;
-    return &get_funccal()->l_avars_var;
+    /* The dict may be used in any way, it must be complete. */
+    fc = get_funccal();
+    add_lazy_args(fc);
+    return &fc->l_avars_var;
 }
 
 /*